@@ -5,9 +5,13 @@
  *
  * This file contains the source code for utility functions used in smallsh.
  * These functions support:
+ *      - Per-command arena allocation
  *      - Debug printing
  *      - Flushed printing to stdout
+ *      - Batched notification output
  *      - Opening files
+ *      - Caching redirection target fds
+ *      - Vectorized byte scanning
  ****************************************************************************/
 
 /*********************************************
@@ -17,31 +21,277 @@
 #include <err.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+/*----------------------------------------------------------------
+ * Vector ISA for the byte scanners, keyed off what the compiler
+ * flags (set in the Makefile) advertise. Without either, the
+ * scanners fall back to plain byte loops.
+ *--------------------------------------------------------------*/
+#if defined( __SSE2__ )
+#include <emmintrin.h>
+#elif defined( __ARM_NEON )
+#include <arm_neon.h>
+#endif
+
+#include "UTL_smallsh.h"
 
 /*********************************************
  *                DEFINES
  ********************************************/
 
-#define FILE_PERM       (0644)
+/* Size of each block carved up by the arena allocator. */
+#define ARENA_BLOCK_SIZE (16384)
+/* Alignment of every allocation handed out by the arena. */
+#define ARENA_ALIGN     (16)
+/* Size of the batched notification output buffer. */
+#define OUT_BUF_SIZE    (4096)
+/* Number of redirection targets kept open across commands. */
+#define REDIR_CACHE_SIZE (16)
+/* Slots in the in-memory trace ring; power of two. */
+#define TRACE_RING_SIZE (1024)
+/* How long the drain thread sleeps between sweeps, in nanoseconds. */
+#define TRACE_DRAIN_NS  (100000000L)
+/* Where a signal-triggered dump lands when no trace file is set. */
+#define TRACE_DUMP_FILE ("smallsh_trace.dump")
+
+/*********************************************
+ *                TYPE DEFS
+ ********************************************/
+
+/* A single block of arena memory. Blocks are chained as demand grows. */
+typedef struct arenaBlock
+{
+    struct arenaBlock  *next;
+    size_t              used;
+    size_t              size;
+    char                mem[];
+} arenaBlock;
+
+/* One entry in the redirection fd cache. An empty path marks a free slot. */
+typedef struct redirCacheEntry
+{
+    char   *path;
+    int     fd;
+    int     flags;
+} redirCacheEntry;
+
+/*----------------------------------------------------------------
+ * One fixed-size binary trace record: when, what, which child,
+ * and a small event-specific payload.
+ *--------------------------------------------------------------*/
+typedef struct traceRecord
+{
+    unsigned long long  ns;
+    int                 event;
+    pid_t               pid;
+    int                 payload;
+} traceRecord;
 
 /*********************************************
  *           FUNCTION PROTOTYPES
  ********************************************/
 
+static void *TraceThreadFn
+        (
+        void               *arg             /* Unused thread argument           */
+        );
+
 
 /*********************************************
  *            MODULE VARIABLES
  ********************************************/
 
+/* Head of the arena block chain. First block is kept across resets. */
+static arenaBlock          *arenaHead       = NULL;
+
+/*----------------------------------------------------------------
+ * Batched notification output. Messages queued here accumulate
+ * until the next safe point flushes them with a single write,
+ * instead of paying an fflush(NULL) per message.
+ *--------------------------------------------------------------*/
+static char                 outBuf[ OUT_BUF_SIZE ];
+static size_t               outLen          = 0;
+
+/*----------------------------------------------------------------
+ * Redirection fd cache: recently-redirected target files kept
+ * open (close-on-exec) across commands, so a loop redirecting
+ * into the same file pays one open() instead of one per command.
+ * Evicted round-robin.
+ *--------------------------------------------------------------*/
+static redirCacheEntry      redirCache[ REDIR_CACHE_SIZE ];
+static size_t               redirCacheNext  = 0;
+
+/*----------------------------------------------------------------
+ * Always-on trace ring. The shell's main thread produces records
+ * at head; when tracing is enabled a drain thread consumes them
+ * at tail into the trace file. Each index has a single writer,
+ * so no lock is involved; a producer that laps an idle consumer
+ * simply overwrites the oldest records.
+ *--------------------------------------------------------------*/
+static traceRecord          traceRing[ TRACE_RING_SIZE ];
+static volatile unsigned    traceHead       = 0;
+static volatile unsigned    traceTail       = 0;
+static int                  traceFd         = -1;
+static bool                 traceDraining   = false;
+static pthread_t            traceThread;
 
 /*********************************************
  *               FUNCTIONS
  ********************************************/
 
+/*****************************************************************************
+ *
+ * NAME
+ *      ArenaNewBlock
+ *
+ * DESCRIPTION
+ *      This function allocates a fresh arena block large enough to satisfy
+ *      a request of the given size and links it at the head of the block
+ *      chain. Exits with failure if the block could not be allocated.
+ *
+ ****************************************************************************/
+
+static arenaBlock *ArenaNewBlock
+    (
+    size_t              n               /* Minimum usable size of the block */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    arenaBlock *lp_block;
+    size_t      size;
+
+    /******************************
+    *  INITIALIZE VARIABLES
+    ******************************/
+    size        = ( n > ARENA_BLOCK_SIZE ) ? n : ARENA_BLOCK_SIZE;
+
+    lp_block = malloc( sizeof( arenaBlock ) + size );
+    if( lp_block == NULL )
+    {
+        fprintf( stderr, "Failed to allocate arena block of size %zu\n", size );
+        exit( EXIT_FAILURE );
+    }
+
+    lp_block->next  = arenaHead;
+    lp_block->used  = 0;
+    lp_block->size  = size;
+    arenaHead       = lp_block;
+
+    return( lp_block );
+
+} /* end - ArenaNewBlock() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      UTL_ArenaAlloc
+ *
+ * DESCRIPTION
+ *      This function carves a zero-initialized allocation of the given size
+ *      out of the per-command arena. Allocations are bump-pointer cheap and
+ *      are all released together by a single call to UTL_ArenaReset.
+ *
+ * NOTES
+ *      Memory returned by this function must NOT be passed to free().
+ *
+ ****************************************************************************/
+
+void *UTL_ArenaAlloc
+    (
+    size_t              n               /* Number of bytes to allocate      */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    arenaBlock *lp_block;
+    void       *lp_mem;
+
+    /******************************
+    *  INITIALIZE VARIABLES
+    ******************************/
+    lp_block    = arenaHead;
+
+    /* Round the request up to the arena alignment. */
+    n = ( n + ARENA_ALIGN - 1 ) & ~( (size_t)ARENA_ALIGN - 1 );
+
+    /* Chain a new block when empty or the current block is exhausted. */
+    if( lp_block == NULL || lp_block->size - lp_block->used < n )
+    {
+        lp_block = ArenaNewBlock( n );
+    }
+
+    /* Bump the cursor past the new allocation. */
+    lp_mem          = lp_block->mem + lp_block->used;
+    lp_block->used += n;
+
+    memset( lp_mem, 0, n );
+
+    return( lp_mem );
+
+} /* end - UTL_ArenaAlloc() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      UTL_ArenaReset
+ *
+ * DESCRIPTION
+ *      This function releases every arena allocation at once by resetting
+ *      the bump cursor of the first block and freeing any overflow blocks.
+ *      The first block is retained so that steady-state command loops reuse
+ *      the same memory with no malloc/free traffic at all.
+ *
+ ****************************************************************************/
+
+int UTL_ArenaReset(void)
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    arenaBlock *lp_block;
+    arenaBlock *lp_next;
+
+    /******************************
+    *  INITIALIZE VARIABLES
+    ******************************/
+    lp_block    = arenaHead;
+
+    /* Free all overflow blocks beyond the first. */
+    while( lp_block != NULL && lp_block->next != NULL )
+    {
+        lp_next = lp_block->next;
+        free( lp_block );
+        lp_block = lp_next;
+    }
+
+    /* Rewind the retained block's cursor. */
+    if( lp_block != NULL )
+    {
+        lp_block->used = 0;
+    }
+
+    arenaHead = lp_block;
+
+    return( EXIT_SUCCESS );
+
+} /* end - UTL_ArenaReset() */
+
+
 /*****************************************************************************
  *
  * NAME
@@ -109,6 +359,150 @@ int UTL_FlushedPrintOut
 
 } /* end - UTL_FlushedPrintOut() */
 
+
+/*****************************************************************************
+ *
+ * NAME
+ *      UTL_FlushOutput
+ *
+ * DESCRIPTION
+ *      This function writes out all queued notification text with a single
+ *      write to stdout and empties the queue. Called at safe points: before
+ *      the interactive prompt and before any blocking wait. Costs nothing
+ *      when the queue is empty.
+ *
+ ****************************************************************************/
+
+int UTL_FlushOutput(void)
+{
+    return( UTL_FlushOutputV( NULL, 0 ) );
+
+} /* end - UTL_FlushOutput() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      UTL_FlushOutputV
+ *
+ * DESCRIPTION
+ *      This function writes out all queued notification text followed by the
+ *      caller's extra segments with a single writev to stdout and empties
+ *      the queue. The interactive prompt composer uses the extra segments to
+ *      append mode-change notices and the prompt itself, so a full prompt
+ *      cycle costs one syscall. Costs nothing when there is nothing to emit.
+ *
+ ****************************************************************************/
+
+int UTL_FlushOutputV
+    (
+    struct iovec       *extra,          /* Segments to write after the queue */
+    int                 extraCount      /* Number of extra segments          */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    struct iovec    iov[ 1 + UTL_FLUSH_MAX_EXTRA ];
+    int             iovCount;
+    int             i;
+
+    /******************************
+    *  INITIALIZE VARIABLES
+    ******************************/
+    iovCount    = 0;
+
+    if( outLen > 0 )
+    {
+        iov[ iovCount ].iov_base    = outBuf;
+        iov[ iovCount ].iov_len     = outLen;
+        iovCount += 1;
+    }
+    for( i = 0; i < extraCount && i < UTL_FLUSH_MAX_EXTRA; i++ )
+    {
+        iov[ iovCount ] = extra[ i ];
+        iovCount += 1;
+    }
+
+    if( iovCount == 0 )
+    {
+        return( EXIT_SUCCESS );
+    }
+
+    /* Keep ordering with any buffered stdio output. */
+    fflush( stdout );
+
+    /* Appease compiler warning; a failed console write is not actionable. */
+    if( writev( STDOUT_FILENO, iov, iovCount ) == -1 )
+    {
+        ;
+    }
+
+    outLen = 0;
+
+    return( EXIT_SUCCESS );
+
+} /* end - UTL_FlushOutputV() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      UTL_QueueOutput
+ *
+ * DESCRIPTION
+ *      This function formats a notification message into the batched output
+ *      buffer without flushing anything. Queued messages are emitted
+ *      together by UTL_FlushOutput at the next safe point, so a burst of
+ *      background-completion notices costs one write instead of a full
+ *      fflush(NULL) apiece.
+ *
+ ****************************************************************************/
+
+int UTL_QueueOutput
+    (
+    char               *stmt,           /* The format string to queue       */
+    ...                                 /* Variable number of arguments     */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    va_list     args;
+    int         n;
+
+    /* Format the message onto the end of the queue. */
+    va_start( args, stmt );
+    n = vsnprintf( outBuf + outLen, OUT_BUF_SIZE - outLen, stmt, args );
+    va_end( args );
+
+    if( n < 0 )
+    {
+        return( EXIT_FAILURE );
+    }
+
+    /* Message did not fit; flush the backlog and format it again. */
+    if( (size_t)n >= OUT_BUF_SIZE - outLen )
+    {
+        UTL_FlushOutput();
+
+        va_start( args, stmt );
+        n = vsnprintf( outBuf, OUT_BUF_SIZE, stmt, args );
+        va_end( args );
+
+        if( n < 0 || (size_t)n >= OUT_BUF_SIZE )
+        {
+            return( EXIT_FAILURE );
+        }
+    }
+
+    outLen += (size_t)n;
+
+    return( EXIT_SUCCESS );
+
+} /* end - UTL_QueueOutput() */
+
+
 /*****************************************************************************
  *
  * NAME
@@ -160,3 +554,654 @@ int UTL_OpenFile
     return( fd );
 
 } /* end - UTL_OpenFile() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      UTL_RedirCacheReset
+ *
+ * DESCRIPTION
+ *      This function empties the redirection fd cache, closing every cached
+ *      fd and freeing every stored path. Entries are keyed by the path
+ *      string as written, so relative-path targets go stale when the
+ *      working directory changes; the cd builtin calls this after a
+ *      successful chdir so they cannot be served from the old directory.
+ *
+ ****************************************************************************/
+
+int UTL_RedirCacheReset(void)
+{
+    for( size_t i = 0; i < REDIR_CACHE_SIZE; i++ )
+    {
+        if( redirCache[ i ].path != NULL )
+        {
+            close( redirCache[ i ].fd );
+            free( redirCache[ i ].path );
+            redirCache[ i ].path = NULL;
+        }
+    }
+    redirCacheNext = 0;
+
+    return( EXIT_SUCCESS );
+
+} /* end - UTL_RedirCacheReset() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      UTL_RedirOpen
+ *
+ * DESCRIPTION
+ *      This function opens a redirection target through the fd cache. A
+ *      cache hit re-arms the already-open fd to look freshly opened
+ *      (truncate-and-rewind for O_TRUNC targets, rewind for reads, nothing
+ *      for appends) and returns it with no syscall against the path at
+ *      all. Cached fds are opened close-on-exec; children dup2 them over
+ *      their stdio, which clears the flag on the duplicate.
+ *
+ * NOTES
+ *      The cache owns the returned fd. Callers must NOT close it. Returns
+ *      -1 when the target cannot be opened.
+ *
+ ****************************************************************************/
+
+int UTL_RedirOpen
+    (
+    const char         *fileName,       /* Name of the file to be opened    */
+    int                 flags           /* open(2) flags for the target     */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    int         fd;
+    size_t      slot;
+
+    /* Probe the cache for the same path opened the same way. */
+    for( size_t i = 0; i < REDIR_CACHE_SIZE; i++ )
+    {
+        if( redirCache[ i ].path != NULL && redirCache[ i ].flags == flags
+         && strcmp( redirCache[ i ].path, fileName ) == 0 )
+        {
+            /* Re-arm the cached fd to look freshly opened. */
+            if( flags & O_TRUNC )
+            {
+                if( ftruncate( redirCache[ i ].fd, 0 ) == -1 )
+                {
+                    break;
+                }
+                lseek( redirCache[ i ].fd, 0, SEEK_SET );
+            }
+            else if( ( flags & O_ACCMODE ) == O_RDONLY )
+            {
+                lseek( redirCache[ i ].fd, 0, SEEK_SET );
+            }
+
+            return( redirCache[ i ].fd );
+        }
+    }
+
+    /* Cache miss: open the target close-on-exec. */
+    fd = open( fileName, flags | O_CLOEXEC, FILE_PERM );
+    if( fd == -1 )
+    {
+        return( -1 );
+    }
+
+    /* Evict the round-robin victim slot and cache the new target. */
+    slot           = redirCacheNext;
+    redirCacheNext = ( redirCacheNext + 1 ) % REDIR_CACHE_SIZE;
+    if( redirCache[ slot ].path != NULL )
+    {
+        close( redirCache[ slot ].fd );
+        free( redirCache[ slot ].path );
+    }
+
+    redirCache[ slot ].path  = strdup( fileName );
+    redirCache[ slot ].fd    = fd;
+    redirCache[ slot ].flags = flags;
+
+    return( fd );
+
+} /* end - UTL_RedirOpen() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      UTL_ScanByteN
+ *
+ * DESCRIPTION
+ *      This function finds the first occurrence of a byte in a
+ *      length-bounded buffer, 16 bytes per step, for scanning regions with
+ *      no terminator such as the mapped batch script. Loads are aligned,
+ *      so the over-read on either end can never cross a page.
+ *
+ * NOTES
+ *      Returns NULL when the byte does not occur, like memchr.
+ *
+ ****************************************************************************/
+
+void *UTL_ScanByteN
+    (
+    const void         *buf,            /* The buffer to scan               */
+    int                 byte,           /* The byte value to find           */
+    size_t              len             /* How many bytes to consider       */
+    )
+{
+#if defined( __SSE2__ )
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    const char     *lp_block;
+    const char     *lp_buf;
+    unsigned        mask;
+    unsigned        pos;
+    unsigned        skip;
+    __m128i         chunk;
+    const __m128i   vTarget = _mm_set1_epi8( (char)byte );
+
+    /******************************
+    *  INITIALIZE VARIABLES
+    ******************************/
+    lp_buf      = buf;
+    lp_block    = (const char *)( (uintptr_t)lp_buf & ~(uintptr_t)15 );
+    skip        = (unsigned)( lp_buf - lp_block );
+
+    for(;;)
+    {
+        chunk = _mm_load_si128( (const __m128i *)lp_block );
+        mask  = (unsigned)_mm_movemask_epi8(
+                    _mm_cmpeq_epi8( chunk, vTarget ) ) >> skip;
+        if( mask != 0 )
+        {
+            pos = (unsigned)( lp_block + skip - lp_buf )
+                + (unsigned)__builtin_ctz( mask );
+            return( ( pos < len ) ? (char *)lp_buf + pos : NULL );
+        }
+        /* Past the end with no hit. */
+        if( (size_t)( lp_block + 16 - lp_buf ) >= len )
+        {
+            return( NULL );
+        }
+        lp_block += 16;
+        skip      = 0;
+    }
+#elif defined( __ARM_NEON )
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    const char     *lp_block;
+    const char     *lp_buf;
+    uint64_t        mask;
+    unsigned        pos;
+    unsigned        skip;
+    uint8x16_t      chunk;
+    const uint8x16_t vTarget = vdupq_n_u8( (uint8_t)byte );
+
+    /******************************
+    *  INITIALIZE VARIABLES
+    ******************************/
+    lp_buf      = buf;
+    lp_block    = (const char *)( (uintptr_t)lp_buf & ~(uintptr_t)15 );
+    skip        = (unsigned)( lp_buf - lp_block );
+
+    for(;;)
+    {
+        chunk = vld1q_u8( (const uint8_t *)lp_block );
+        /* Narrow the per-byte compare into four mask bits per byte. */
+        mask  = vget_lane_u64( vreinterpret_u64_u8( vshrn_n_u16(
+                    vreinterpretq_u16_u8( vceqq_u8( chunk, vTarget ) ),
+                    4 ) ), 0 ) >> ( skip * 4 );
+        if( mask != 0 )
+        {
+            pos = (unsigned)( lp_block + skip - lp_buf )
+                + (unsigned)( __builtin_ctzll( mask ) >> 2 );
+            return( ( pos < len ) ? (char *)lp_buf + pos : NULL );
+        }
+        /* Past the end with no hit. */
+        if( (size_t)( lp_block + 16 - lp_buf ) >= len )
+        {
+            return( NULL );
+        }
+        lp_block += 16;
+        skip      = 0;
+    }
+#else
+    return( memchr( buf, byte, len ) );
+#endif
+
+} /* end - UTL_ScanByteN() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      UTL_ScanSkip
+ *
+ * DESCRIPTION
+ *      This function measures the leading run of two delimiter bytes - the
+ *      length of the prefix made up solely of a and b - 16 bytes per step.
+ *      A NUL always ends the run, so the scan cannot leave the string.
+ *
+ ****************************************************************************/
+
+size_t UTL_ScanSkip
+    (
+    const char         *str,            /* The string to scan               */
+    char                a,              /* First delimiter byte             */
+    char                b               /* Second delimiter byte            */
+    )
+{
+#if defined( __SSE2__ )
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    const char     *lp_block;
+    unsigned        mask;
+    unsigned        skip;
+    __m128i         chunk;
+    const __m128i   vA = _mm_set1_epi8( a );
+    const __m128i   vB = _mm_set1_epi8( b );
+
+    /******************************
+    *  INITIALIZE VARIABLES
+    ******************************/
+    lp_block    = (const char *)( (uintptr_t)str & ~(uintptr_t)15 );
+    skip        = (unsigned)( str - lp_block );
+
+    for(;;)
+    {
+        chunk = _mm_load_si128( (const __m128i *)lp_block );
+        /* A set bit marks a byte that is neither delimiter. */
+        mask  = ( ~(unsigned)_mm_movemask_epi8( _mm_or_si128(
+                      _mm_cmpeq_epi8( chunk, vA ),
+                      _mm_cmpeq_epi8( chunk, vB ) ) ) & 0xFFFFu ) >> skip;
+        if( mask != 0 )
+        {
+            return( ( lp_block + skip + __builtin_ctz( mask ) ) - str );
+        }
+        lp_block += 16;
+        skip      = 0;
+    }
+#elif defined( __ARM_NEON )
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    const char     *lp_block;
+    uint64_t        mask;
+    unsigned        skip;
+    uint8x16_t      chunk;
+    const uint8x16_t vA = vdupq_n_u8( (uint8_t)a );
+    const uint8x16_t vB = vdupq_n_u8( (uint8_t)b );
+
+    /******************************
+    *  INITIALIZE VARIABLES
+    ******************************/
+    lp_block    = (const char *)( (uintptr_t)str & ~(uintptr_t)15 );
+    skip        = (unsigned)( str - lp_block );
+
+    for(;;)
+    {
+        chunk = vld1q_u8( (const uint8_t *)lp_block );
+        /* A set nibble marks a byte that is neither delimiter. */
+        mask  = ~vget_lane_u64( vreinterpret_u64_u8( vshrn_n_u16(
+                    vreinterpretq_u16_u8( vorrq_u8(
+                        vceqq_u8( chunk, vA ),
+                        vceqq_u8( chunk, vB ) ) ), 4 ) ), 0 )
+              >> ( skip * 4 );
+        if( mask != 0 )
+        {
+            return( ( lp_block + skip + ( __builtin_ctzll( mask ) >> 2 ) )
+                  - str );
+        }
+        lp_block += 16;
+        skip      = 0;
+    }
+#else
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    size_t      i;
+
+    for( i = 0; str[ i ] == a || str[ i ] == b; i++ )
+    {
+        ;
+    }
+    return( i );
+#endif
+
+} /* end - UTL_ScanSkip() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      UTL_ScanSpan
+ *
+ * DESCRIPTION
+ *      This function measures the span up to the first occurrence of
+ *      either of two bytes or the terminating NUL, 16 bytes per step. Pass
+ *      the same byte twice to scan for a single value. Loads are aligned,
+ *      so the over-read past the terminator can never cross a page.
+ *
+ ****************************************************************************/
+
+size_t UTL_ScanSpan
+    (
+    const char         *str,            /* The string to scan               */
+    char                a,              /* First byte to stop at            */
+    char                b               /* Second byte to stop at           */
+    )
+{
+#if defined( __SSE2__ )
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    const char     *lp_block;
+    unsigned        mask;
+    unsigned        skip;
+    __m128i         chunk;
+    __m128i         hits;
+    const __m128i   vA    = _mm_set1_epi8( a );
+    const __m128i   vB    = _mm_set1_epi8( b );
+    const __m128i   vZero = _mm_setzero_si128();
+
+    /******************************
+    *  INITIALIZE VARIABLES
+    ******************************/
+    lp_block    = (const char *)( (uintptr_t)str & ~(uintptr_t)15 );
+    skip        = (unsigned)( str - lp_block );
+
+    for(;;)
+    {
+        chunk = _mm_load_si128( (const __m128i *)lp_block );
+        hits  = _mm_or_si128( _mm_cmpeq_epi8( chunk, vA ),
+                              _mm_cmpeq_epi8( chunk, vB ) );
+        hits  = _mm_or_si128( hits, _mm_cmpeq_epi8( chunk, vZero ) );
+        mask  = (unsigned)_mm_movemask_epi8( hits ) >> skip;
+        if( mask != 0 )
+        {
+            return( ( lp_block + skip + __builtin_ctz( mask ) ) - str );
+        }
+        lp_block += 16;
+        skip      = 0;
+    }
+#elif defined( __ARM_NEON )
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    const char     *lp_block;
+    uint64_t        mask;
+    unsigned        skip;
+    uint8x16_t      chunk;
+    uint8x16_t      hits;
+    const uint8x16_t vA = vdupq_n_u8( (uint8_t)a );
+    const uint8x16_t vB = vdupq_n_u8( (uint8_t)b );
+
+    /******************************
+    *  INITIALIZE VARIABLES
+    ******************************/
+    lp_block    = (const char *)( (uintptr_t)str & ~(uintptr_t)15 );
+    skip        = (unsigned)( str - lp_block );
+
+    for(;;)
+    {
+        chunk = vld1q_u8( (const uint8_t *)lp_block );
+        hits  = vorrq_u8( vceqq_u8( chunk, vA ), vceqq_u8( chunk, vB ) );
+        hits  = vorrq_u8( hits, vceqq_u8( chunk, vdupq_n_u8( 0 ) ) );
+        mask  = vget_lane_u64( vreinterpret_u64_u8( vshrn_n_u16(
+                    vreinterpretq_u16_u8( hits ), 4 ) ), 0 )
+              >> ( skip * 4 );
+        if( mask != 0 )
+        {
+            return( ( lp_block + skip + ( __builtin_ctzll( mask ) >> 2 ) )
+                  - str );
+        }
+        lp_block += 16;
+        skip      = 0;
+    }
+#else
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    size_t      i;
+
+    for( i = 0; str[ i ] != '\0' && str[ i ] != a && str[ i ] != b; i++ )
+    {
+        ;
+    }
+    return( i );
+#endif
+
+} /* end - UTL_ScanSpan() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      TraceThreadFn
+ *
+ * DESCRIPTION
+ *      Thread entry for the trace drain. Sleeps between sweeps, then
+ *      writes every record produced since the last sweep to the trace
+ *      file in at most two contiguous writes. A producer that laps the
+ *      drain loses the oldest records rather than ever blocking.
+ *
+ ****************************************************************************/
+
+static void *TraceThreadFn
+    (
+    void               *arg             /* Unused thread argument           */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    unsigned            head;
+    struct timespec     nap;
+    unsigned            slot;
+    unsigned            span;
+
+    /******************************
+    *  INITIALIZE VARIABLES
+    ******************************/
+    nap.tv_sec  = 0;
+    nap.tv_nsec = TRACE_DRAIN_NS;
+
+    /* Appease compiler warning. */
+    if( arg )
+    {
+        ;
+    }
+
+    for(;;)
+    {
+        nanosleep( &nap, NULL );
+
+        /* Snapshot head once; records beyond it belong to next sweep. */
+        head = traceHead;
+
+        /* Lapped: skip forward to the oldest record still present. */
+        if( head - traceTail > TRACE_RING_SIZE )
+        {
+            traceTail = head - TRACE_RING_SIZE;
+        }
+
+        /* Drain in contiguous runs so each sweep costs few writes. */
+        while( traceTail != head )
+        {
+            slot = traceTail & ( TRACE_RING_SIZE - 1 );
+            span = head - traceTail;
+            if( span > TRACE_RING_SIZE - slot )
+            {
+                span = TRACE_RING_SIZE - slot;
+            }
+
+            if( write( traceFd, &traceRing[ slot ],
+                       span * sizeof( traceRecord ) ) == -1 )
+            {
+                ;
+            }
+            traceTail += span;
+        }
+    }
+
+    return( NULL );
+
+} /* end - TraceThreadFn() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      UTL_Trace
+ *
+ * DESCRIPTION
+ *      This function appends one binary record to the in-memory trace
+ *      ring: raw monotonic timestamp, event id, pid, and a small payload.
+ *      The cost is one clock read and four stores, cheap enough to leave
+ *      on in production; nothing is formatted and nothing blocks.
+ *
+ ****************************************************************************/
+
+int UTL_Trace
+    (
+    int                 event,          /* Which lifecycle point fired      */
+    pid_t               pid,            /* The child involved, or 0         */
+    int                 payload         /* Small event-specific detail      */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    struct timespec     now;
+    unsigned            slot;
+
+    clock_gettime( CLOCK_MONOTONIC_RAW, &now );
+
+    slot = traceHead & ( TRACE_RING_SIZE - 1 );
+    traceRing[ slot ].ns      = (unsigned long long)now.tv_sec * 1000000000ull
+                              + (unsigned long long)now.tv_nsec;
+    traceRing[ slot ].event   = event;
+    traceRing[ slot ].pid     = pid;
+    traceRing[ slot ].payload = payload;
+    traceHead = traceHead + 1;
+
+    return( EXIT_SUCCESS );
+
+} /* end - UTL_Trace() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      UTL_TraceDump
+ *
+ * DESCRIPTION
+ *      This function dumps the whole trace ring, oldest record first, for
+ *      post-mortem of a hung shell. The dump goes to the trace file when
+ *      one is open, otherwise to a dump file created on the spot. Built
+ *      from open/write/close only, so it is safe to call straight from a
+ *      signal handler.
+ *
+ ****************************************************************************/
+
+int UTL_TraceDump(void)
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    int                 fd;
+    unsigned            head;
+    unsigned            slot;
+    unsigned            span;
+    unsigned            tail;
+
+    /******************************
+    *  INITIALIZE VARIABLES
+    ******************************/
+    fd   = traceFd;
+    head = traceHead;
+
+    if( fd == -1 )
+    {
+        fd = open( TRACE_DUMP_FILE, O_WRONLY | O_CREAT | O_TRUNC, FILE_PERM );
+        if( fd == -1 )
+        {
+            return( EXIT_FAILURE );
+        }
+    }
+
+    /* Everything still in the ring, oldest first. */
+    tail = ( head > TRACE_RING_SIZE ) ? head - TRACE_RING_SIZE : 0;
+    while( tail != head )
+    {
+        slot = tail & ( TRACE_RING_SIZE - 1 );
+        span = head - tail;
+        if( span > TRACE_RING_SIZE - slot )
+        {
+            span = TRACE_RING_SIZE - slot;
+        }
+
+        if( write( fd, &traceRing[ slot ], span * sizeof( traceRecord ) ) == -1 )
+        {
+            ;
+        }
+        tail += span;
+    }
+
+    if( fd != traceFd )
+    {
+        close( fd );
+    }
+
+    return( EXIT_SUCCESS );
+
+} /* end - UTL_TraceDump() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      UTL_TraceInit
+ *
+ * DESCRIPTION
+ *      This function arms the trace drain when the TRACE_ENV environment
+ *      variable names a trace file: the file is created and a background
+ *      thread starts sweeping the ring into it. Without the variable the
+ *      ring still records - it always does - but nothing touches disk
+ *      unless a dump is requested by signal.
+ *
+ ****************************************************************************/
+
+int UTL_TraceInit(void)
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    char       *lp_tracePath;
+
+    lp_tracePath = getenv( TRACE_ENV );
+    if( lp_tracePath == NULL || lp_tracePath[ 0 ] == '\0' )
+    {
+        return( EXIT_SUCCESS );
+    }
+
+    traceFd = open( lp_tracePath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, FILE_PERM );
+    if( traceFd == -1 )
+    {
+        fprintf( stderr, "cannot open trace file %s\n", lp_tracePath );
+        return( EXIT_FAILURE );
+    }
+
+    if( pthread_create( &traceThread, NULL, TraceThreadFn, NULL ) == 0 )
+    {
+        traceDraining = true;
+    }
+
+    return( EXIT_SUCCESS );
+
+} /* end - UTL_TraceInit() */
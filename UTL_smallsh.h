@@ -17,6 +17,9 @@
  *                INCLUDES
  ********************************************/
 
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/uio.h>
 
 /*********************************************
  *                DEFINES
@@ -25,18 +28,43 @@
 #define TRUE    (true)
 #define FALSE   (false)
 
+/* Permissions for files created by redirection. */
+#define FILE_PERM       (0644)
+
 #define OPEN_FILE_READ( _fp )   UTL_OpenFile( _fp, TRUE, FALSE )
 #define OPEN_FILE_WRITE( _fp )  UTL_OpenFile( _fp, FALSE, TRUE )
 
+/* Environment variable naming the trace drain file. */
+#define TRACE_ENV       ("SMALLSH_TRACE")
+
+/* Most extra segments a caller may hand to UTL_FlushOutputV. */
+#define UTL_FLUSH_MAX_EXTRA (4)
+
+/* Trace event ids, one per traced lifecycle point. */
+#define UTL_TRACE_PARSE (1)
+#define UTL_TRACE_FORK  (2)
+#define UTL_TRACE_EXEC  (3)
+#define UTL_TRACE_REAP  (4)
+
 /*********************************************
  *                TYPE DEFS
  ********************************************/
 
 
 /*********************************************
- *           FUNCTION PROTOTYPES          
+ *           FUNCTION PROTOTYPES
  ********************************************/
 
+void *UTL_ArenaAlloc
+        (
+        size_t              n               /* Number of bytes to allocate      */
+        );
+
+int UTL_ArenaReset
+        (
+        void
+        );
+
 int UTL_DebugPrint
         (
         char               *stmt,           /* The format string to print out   */
@@ -49,6 +77,24 @@ int UTL_FlushedPrintOut
         ...                                 /* Variable number of arguments     */
         );
 
+int UTL_FlushOutput
+        (
+        void
+        );
+
+int UTL_FlushOutputV
+        (
+        struct iovec       *extra,          /* Segments to write after the
+                                               queued notifications          */
+        int                 extraCount      /* Number of extra segments      */
+        );
+
+int UTL_QueueOutput
+        (
+        char               *stmt,           /* The format string to queue       */
+        ...                                 /* Variable number of arguments     */
+        );
+
 int UTL_OpenFile
         (
         const char         *fileName,       /* Name of the file to be opened    */
@@ -56,4 +102,53 @@ int UTL_OpenFile
         bool                isWriteOnly     /* Open in write only mode          */
         );
 
+int UTL_RedirCacheReset
+        (
+        void
+        );
+
+int UTL_RedirOpen
+        (
+        const char         *fileName,       /* Name of the file to be opened    */
+        int                 flags           /* open(2) flags for the target     */
+        );
+
+void *UTL_ScanByteN
+        (
+        const void         *buf,            /* The buffer to scan               */
+        int                 byte,           /* The byte value to find           */
+        size_t              len             /* How many bytes to consider       */
+        );
+
+size_t UTL_ScanSkip
+        (
+        const char         *str,            /* The string to scan               */
+        char                a,              /* First delimiter byte             */
+        char                b               /* Second delimiter byte            */
+        );
+
+size_t UTL_ScanSpan
+        (
+        const char         *str,            /* The string to scan               */
+        char                a,              /* First byte to stop at            */
+        char                b               /* Second byte to stop at           */
+        );
+
+int UTL_Trace
+        (
+        int                 event,          /* Which lifecycle point fired      */
+        pid_t               pid,            /* The child involved, or 0         */
+        int                 payload         /* Small event-specific detail      */
+        );
+
+int UTL_TraceDump
+        (
+        void
+        );
+
+int UTL_TraceInit
+        (
+        void
+        );
+
 #endif
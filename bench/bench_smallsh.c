@@ -0,0 +1,362 @@
+/*****************************************************************************
+ * Author: Marc Zalik
+ * Date: 2026-08-31
+ * Filename: bench_smallsh.c
+ *
+ * This file contains the source code for the smallsh benchmark harness. It
+ * generates synthetic workload scripts - empty builtins, $$-heavy argument
+ * lists, fork/exec storms, and background job churn - drives them through
+ * the smallsh binary in batch mode, and reports commands/sec per workload
+ * along with launch-to-exit latency percentiles. Run via 'make bench' to
+ * validate performance changes and catch regressions between releases.
+ ****************************************************************************/
+
+/*********************************************
+ *                INCLUDES
+ ********************************************/
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/*********************************************
+ *                DEFINES
+ ********************************************/
+
+/* Commands per throughput workload. */
+#define PARSE_CMDS      (20000)
+#define BUILTIN_CMDS    (20000)
+#define FORK_CMDS       (300)
+#define CHURN_CMDS      (300)
+#define FULLARGS_CMDS   (300)
+/* Samples for the launch latency distribution. */
+#define LATENCY_RUNS    (100)
+
+#define NSEC_PER_SEC    (1000000000.0)
+
+/*********************************************
+ *           FUNCTION PROTOTYPES
+ ********************************************/
+
+static double   ElapsedSec
+                    (
+                    struct timespec    *start,          /* Interval start timestamp         */
+                    struct timespec    *end             /* Interval end timestamp           */
+                    );
+
+static int      CompareDouble
+                    (
+                    const void         *a,              /* First element to compare         */
+                    const void         *b               /* Second element to compare        */
+                    );
+
+static double   RunShell
+                    (
+                    const char         *shell,          /* Path to the smallsh binary       */
+                    const char         *script          /* Path to the workload script      */
+                    );
+
+static int      RunWorkload
+                    (
+                    const char         *shell,          /* Path to the smallsh binary       */
+                    const char         *name,           /* Workload name for the report     */
+                    const char         *script,        /* Path to the workload script      */
+                    int                 count           /* Number of commands in the script */
+                    );
+
+static int      WriteWorkload
+                    (
+                    const char         *path,           /* Where to write the script        */
+                    const char         *line,           /* The command line to repeat       */
+                    int                 count,          /* Number of times to repeat it     */
+                    const char         *tail            /* Final line, or NULL              */
+                    );
+
+/*********************************************
+ *               FUNCTIONS
+ ********************************************/
+
+/*****************************************************************************
+ *
+ * NAME
+ *      main
+ *
+ * DESCRIPTION
+ *      This function generates each synthetic workload script, drives it
+ *      through the smallsh binary given as argv[1] (default ./smallsh),
+ *      and prints the throughput and latency report.
+ *
+ ****************************************************************************/
+
+int main
+    (
+    int                 argc,           /* Number of command line arguments */
+    char               *argv[]          /* Command line argument values     */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    double      latency[ LATENCY_RUNS ];
+    const char *lp_shell;
+
+    /******************************
+    *  INITIALIZE VARIABLES
+    ******************************/
+    lp_shell    = ( argc > 1 ) ? argv[ 1 ] : "./smallsh";
+
+    printf( "smallsh benchmark: %s\n\n", lp_shell );
+    printf( "%-20s %12s %14s\n", "workload", "commands", "commands/sec" );
+
+    /* Parser-only workload: comment lines exercise parse + dispatch. */
+    WriteWorkload( "/tmp/bench_parse.sh", "# comment line with several tokens to parse", PARSE_CMDS, NULL );
+    RunWorkload( lp_shell, "parse-only", "/tmp/bench_parse.sh", PARSE_CMDS );
+
+    /* Empty-builtin workload: status has no side effects beyond a print. */
+    WriteWorkload( "/tmp/bench_builtin.sh", "status", BUILTIN_CMDS, NULL );
+    RunWorkload( lp_shell, "builtin-status", "/tmp/bench_builtin.sh", BUILTIN_CMDS );
+
+    /* $$-heavy workload: every token needs pid expansion. */
+    WriteWorkload( "/tmp/bench_expand.sh", "# $$_a_$$ $$_b_$$ $$_c_$$ $$_d_$$ $$_e_$$", PARSE_CMDS, NULL );
+    RunWorkload( lp_shell, "pid-expansion", "/tmp/bench_expand.sh", PARSE_CMDS );
+
+    /* Fork/exec storm: every command launches a child. */
+    WriteWorkload( "/tmp/bench_fork.sh", "true", FORK_CMDS, NULL );
+    RunWorkload( lp_shell, "fork-storm", "/tmp/bench_fork.sh", FORK_CMDS );
+
+    /* Background churn: job table insert/reap under load. */
+    WriteWorkload( "/tmp/bench_churn.sh", "true &", CHURN_CMDS, "sleep 1" );
+    RunWorkload( lp_shell, "background-churn", "/tmp/bench_churn.sh", CHURN_CMDS );
+
+    /*----------------------------------------------------------------
+     * Full-args stress: the substitution floods args[] to the
+     * MAX_ARGS cap with trailing tokens left over, so any missing
+     * bound on the parser's argument stores crashes the run here
+     * instead of in the field.
+     *--------------------------------------------------------------*/
+    WriteWorkload( "/tmp/bench_fullargs.sh", "echo $(seq 1 600) a b c", FULLARGS_CMDS, NULL );
+    RunWorkload( lp_shell, "full-args", "/tmp/bench_fullargs.sh", FULLARGS_CMDS );
+
+    /*----------------------------------------------------------------
+     * Launch latency: time the full launch-to-exit of a one-command
+     * script many times and report the distribution.
+     *--------------------------------------------------------------*/
+    WriteWorkload( "/tmp/bench_lat.sh", "status", 1, NULL );
+    for( int i = 0; i < LATENCY_RUNS; i++ )
+    {
+        latency[ i ] = RunShell( lp_shell, "/tmp/bench_lat.sh" );
+    }
+    qsort( latency, LATENCY_RUNS, sizeof( double ), CompareDouble );
+
+    printf( "\nlaunch-to-exit latency over %d runs:\n", LATENCY_RUNS );
+    printf( "    p50 %8.3f ms\n", latency[ LATENCY_RUNS / 2 ] * 1000.0 );
+    printf( "    p95 %8.3f ms\n", latency[ ( LATENCY_RUNS * 95 ) / 100 ] * 1000.0 );
+    printf( "    p99 %8.3f ms\n", latency[ ( LATENCY_RUNS * 99 ) / 100 ] * 1000.0 );
+
+    return( EXIT_SUCCESS );
+
+} /* end - main() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      CompareDouble
+ *
+ * DESCRIPTION
+ *      qsort comparator for doubles, ascending.
+ *
+ ****************************************************************************/
+
+static int CompareDouble
+    (
+    const void         *a,              /* First element to compare         */
+    const void         *b               /* Second element to compare        */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    double      da;
+    double      db;
+
+    /******************************
+    *  INITIALIZE VARIABLES
+    ******************************/
+    da          = *(const double *)a;
+    db          = *(const double *)b;
+
+    if( da < db )
+    {
+        return( -1 );
+    }
+    if( da > db )
+    {
+        return( 1 );
+    }
+
+    return( 0 );
+
+} /* end - CompareDouble() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      ElapsedSec
+ *
+ * DESCRIPTION
+ *      This function returns the elapsed time between two timespecs in
+ *      seconds.
+ *
+ ****************************************************************************/
+
+static double ElapsedSec
+    (
+    struct timespec    *start,          /* Interval start timestamp         */
+    struct timespec    *end             /* Interval end timestamp           */
+    )
+{
+    return( ( end->tv_sec - start->tv_sec )
+          + ( end->tv_nsec - start->tv_nsec ) / NSEC_PER_SEC );
+
+} /* end - ElapsedSec() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      RunShell
+ *
+ * DESCRIPTION
+ *      This function runs the smallsh binary on the given workload script
+ *      with stdout discarded, waits for it to finish, and returns the
+ *      elapsed wall time in seconds.
+ *
+ ****************************************************************************/
+
+static double RunShell
+    (
+    const char         *shell,          /* Path to the smallsh binary       */
+    const char         *script         /* Path to the workload script      */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    struct timespec     end;
+    int                 nullFd;
+    pid_t               pid;
+    struct timespec     start;
+    int                 status;
+
+    clock_gettime( CLOCK_MONOTONIC, &start );
+
+    pid = fork();
+    if( pid == -1 )
+    {
+        fprintf( stderr, "Failed to fork shell under test\n" );
+        exit( EXIT_FAILURE );
+    }
+
+    /* Child: silence stdout and exec the shell on the script. */
+    if( pid == 0 )
+    {
+        nullFd = open( "/dev/null", O_WRONLY );
+        dup2( nullFd, STDOUT_FILENO );
+        execl( shell, shell, script, (char *)NULL );
+        fprintf( stderr, "Failed to exec %s\n", shell );
+        exit( EXIT_FAILURE );
+    }
+
+    waitpid( pid, &status, 0 );
+
+    clock_gettime( CLOCK_MONOTONIC, &end );
+
+    return( ElapsedSec( &start, &end ) );
+
+} /* end - RunShell() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      RunWorkload
+ *
+ * DESCRIPTION
+ *      This function times one throughput workload and prints its line of
+ *      the report.
+ *
+ ****************************************************************************/
+
+static int RunWorkload
+    (
+    const char         *shell,          /* Path to the smallsh binary       */
+    const char         *name,           /* Workload name for the report     */
+    const char         *script,        /* Path to the workload script      */
+    int                 count           /* Number of commands in the script */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    double      elapsed;
+
+    elapsed = RunShell( shell, script );
+
+    printf( "%-20s %12d %14.0f\n", name, count, count / elapsed );
+
+    return( EXIT_SUCCESS );
+
+} /* end - RunWorkload() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      WriteWorkload
+ *
+ * DESCRIPTION
+ *      This function writes a workload script consisting of the given
+ *      command line repeated count times, plus an optional tail line.
+ *
+ ****************************************************************************/
+
+static int WriteWorkload
+    (
+    const char         *path,           /* Where to write the script        */
+    const char         *line,           /* The command line to repeat       */
+    int                 count,          /* Number of times to repeat it     */
+    const char         *tail            /* Final line, or NULL              */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    FILE       *lp_file;
+
+    lp_file = fopen( path, "w" );
+    if( lp_file == NULL )
+    {
+        fprintf( stderr, "Failed to open workload script %s\n", path );
+        exit( EXIT_FAILURE );
+    }
+
+    for( int i = 0; i < count; i++ )
+    {
+        fprintf( lp_file, "%s\n", line );
+    }
+    if( tail != NULL )
+    {
+        fprintf( lp_file, "%s\n", tail );
+    }
+
+    fclose( lp_file );
+
+    return( EXIT_SUCCESS );
+
+} /* end - WriteWorkload() */
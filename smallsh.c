@@ -17,11 +17,29 @@
  *                INCLUDES
  ********************************************/
 
+/* For memfd_create and the F_ADD_SEALS fcntl. */
+#define _GNU_SOURCE
+
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
 #include <signal.h>
+#include <spawn.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/syscall.h>
+#include <termios.h>
 #include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "smallsh.h"
@@ -31,6 +49,246 @@
  *                DEFINES
  ********************************************/
 
+/* Number of slots in the PATH resolution cache. Must be a power of two. */
+#define PATH_CACHE_SIZE (256)
+/* Maximum length of a resolved executable path. */
+#define PATH_MAX_LEN    (4096)
+/*----------------------------------------------------------------
+ * Environment lookup cache: slot count (power of two) and the
+ * longest name a $NAME or ${NAME} reference may carry.
+ *--------------------------------------------------------------*/
+#define ENV_CACHE_SIZE  (64)
+#define ENV_NAME_MAX    (128)
+/* Size of each block read when slurping a batch script from a pipe. */
+#define BATCH_CHUNK_SIZE (65536)
+/* Initial capacity of the job table. Doubles on demand. */
+#define JOB_TABLE_INIT  (16)
+/*----------------------------------------------------------------
+ * Size of the builtin dispatch table. Kept sparse (power of two,
+ * several times the builtin count) so external commands - the
+ * common case - nearly always miss on their first probe.
+ *--------------------------------------------------------------*/
+#define BUILTIN_TABLE_SIZE (32)
+/*----------------------------------------------------------------
+ * Size of the alias table, sparse for the same reason: unaliased
+ * command names - the common case - miss on their first probe.
+ *--------------------------------------------------------------*/
+#define ALIAS_TABLE_SIZE (64)
+/* Length cap for the command name cached per job. */
+#define JOB_NAME_LEN    (64)
+/* Number of finished-job records kept in the rolling ring. */
+#define JOB_RING_SIZE   (32)
+/*----------------------------------------------------------------
+ * History subsystem: entries recallable in memory, the log file
+ * name (under HOME), the granularity the mmap append window grows
+ * by, and how many appends ride between msync batches.
+ *--------------------------------------------------------------*/
+#define HIST_RING_SIZE  (64)
+#define HIST_FILE       (".smallsh_history")
+#define HIST_MAP_CHUNK  (65536)
+#define HIST_SYNC_EVERY (32)
+/*----------------------------------------------------------------
+ * Glob engine: directories whose listings stay cached between
+ * globs, and the size of the reusable getdents64 batch buffer.
+ *--------------------------------------------------------------*/
+#define GLOB_CACHE_SIZE (8)
+#define GLOB_DENT_BUF   (32768)
+/*----------------------------------------------------------------
+ * Startup rc file: the source (under HOME), the compiled cache
+ * kept beside it, the magic and version stamped on the cache, its
+ * two record kinds, and the longest rc line honored.
+ *--------------------------------------------------------------*/
+#define RC_FILE         (".smallshrc")
+#define RC_CACHE_FILE   (".smallshrc.bin")
+#define RC_MAGIC        (0x52434243u)
+#define RC_VERSION      (1)
+#define RC_REC_TOKENS   (1)
+#define RC_REC_TEXT     (2)
+#define RC_LINE_MAX     (4096)
+/* Flag bits packed into a serialized rc command record. */
+#define RC_FLAG_BACKGROUND  (0x1)
+#define RC_FLAG_REDIR_IN    (0x2)
+#define RC_FLAG_REDIR_OUT   (0x4)
+#define RC_FLAG_APPEND      (0x8)
+/* Most completion candidates considered for one Tab press. */
+#define COMPLETE_MAX    (256)
+/* Longest $( ) body and most words its inner command may have. */
+#define SUBST_MAX_LEN   (4096)
+#define SUBST_MAX_ARGS  (64)
+/* Slots in the SIGCHLD handler's exit-event ring; power of two. */
+#define CHLD_RING_SIZE  (64)
+/*----------------------------------------------------------------
+ * Interactive prompt text. The composer measures these with
+ * sizeof, so the strings and their lengths cannot drift apart.
+ *--------------------------------------------------------------*/
+#define PROMPT_STR          (": ")
+#define FG_ONLY_ENTER_MSG   ("\nEntering foreground-only mode (& is now ignored)\n")
+#define FG_ONLY_EXIT_MSG    ("\nExiting foreground-only mode\n")
+/* Daemon mode: longest request line, listen backlog, and the control
+   byte framing the exit status as the last line of a response. */
+#define DAEMON_LINE_MAX (8192)
+#define DAEMON_BACKLOG  (16)
+#define DAEMON_MARK     ('\x1e')
+/*----------------------------------------------------------------
+ * Command-list scheduler limits: the hard bound on concurrent ';'
+ * members, and the cap used when SMALLSH_JOBS is set without a
+ * usable number. Fan-out is opt-in: with SMALLSH_JOBS unset, ';'
+ * members run strictly in order.
+ *--------------------------------------------------------------*/
+#define SCHED_MAX_ACTIVE     (32)
+#define SCHED_DEFAULT_ACTIVE (8)
+
+/*----------------------------------------------------------------
+ * Hot-path instrumentation stages. Each stage accumulates into a
+ * log2-bucketed nanosecond histogram read by the stats builtin.
+ *--------------------------------------------------------------*/
+#define STAT_STAGE_GETINPUT (0)
+#define STAT_STAGE_PARSE    (1)
+#define STAT_STAGE_RUN      (2)
+#define STAT_STAGE_FREE     (3)
+#define STAT_STAGE_LAUNCH   (4)
+#define STAT_STAGE_REAP     (5)
+#define STAT_NUM_STAGES     (6)
+#define STAT_NUM_BUCKETS    (64)
+#define NSEC_PER_SEC        (1000000000L)
+
+/*********************************************
+ *                TYPE DEFS
+ ********************************************/
+
+/* One entry in the PATH resolution cache. */
+typedef struct pathCacheEntry
+{
+    char   *name;
+    char   *path;
+} pathCacheEntry;
+
+/* One entry in the environment lookup cache. A NULL value records a
+   variable that was unset at lookup time. */
+typedef struct envCacheEntry
+{
+    char   *name;
+    char   *value;
+} envCacheEntry;
+
+/* One slot in the job table. A pid of 0 marks a free slot. */
+typedef struct jobSlot
+{
+    pid_t           pid;
+    int             nextFree;
+    /* Cached in-process so listing jobs is a memory walk. */
+    struct timespec start;
+    char            name[ JOB_NAME_LEN ];
+} jobSlot;
+
+/*----------------------------------------------------------------
+ * One entry in the pid-to-slot hash index over the job table.
+ * A pid of 0 marks an empty entry, -1 a tombstone left by removal.
+ *--------------------------------------------------------------*/
+typedef struct jobHashEntry
+{
+    pid_t   pid;
+    int     slot;
+} jobHashEntry;
+
+/*----------------------------------------------------------------
+ * One record in the rolling ring of finished jobs: identity, exit
+ * status, wall time, and the rusage captured by wait4 at reap
+ * time. Read back by 'status -v'.
+ *--------------------------------------------------------------*/
+typedef struct jobRecord
+{
+    pid_t               pid;
+    int                 status;
+    unsigned long long  wallNs;
+    struct timeval      userTime;
+    struct timeval      sysTime;
+    long                maxRss;
+    char                name[ JOB_NAME_LEN ];
+} jobRecord;
+
+/*----------------------------------------------------------------
+ * One child-exit event as captured inside the SIGCHLD handler:
+ * everything wait4 reported, queued for the main loop to account
+ * for at its leisure.
+ *--------------------------------------------------------------*/
+typedef struct chldEvent
+{
+    pid_t               pid;
+    int                 status;
+    struct rusage       usage;
+} chldEvent;
+
+/* Raw dirent record as returned by the getdents64 syscall. */
+typedef struct linuxDirent64
+{
+    unsigned long long  d_ino;
+    long long           d_off;
+    unsigned short      d_reclen;
+    unsigned char       d_type;
+    char                d_name[];
+} linuxDirent64;
+
+/*----------------------------------------------------------------
+ * One cached directory listing for the glob engine. Names are
+ * packed NUL-terminated into one blob with an index over them;
+ * the (dev, inode, mtime) key detects when the directory has
+ * changed and the listing must be rescanned.
+ *--------------------------------------------------------------*/
+typedef struct globDirEntry
+{
+    char               *path;
+    dev_t               dev;
+    ino_t               ino;
+    struct timespec     mtime;
+    char               *blob;
+    size_t              blobLen;
+    char              **names;
+    size_t              numNames;
+} globDirEntry;
+
+/*----------------------------------------------------------------
+ * Header of the compiled rc cache. The source mtime and size gate
+ * reuse; the checksum guards the payload against torn writes.
+ *--------------------------------------------------------------*/
+typedef struct rcCacheHeader
+{
+    unsigned            magic;
+    unsigned            version;
+    long long           srcMtimeSec;
+    long long           srcMtimeNsec;
+    long long           srcSize;
+    unsigned long long  checksum;
+    unsigned            numCmds;
+    unsigned            payloadLen;
+} rcCacheHeader;
+
+/* One entry in the builtin dispatch table. */
+typedef struct builtinEntry
+{
+    const char *name;
+    int       (*handler)( cmdStruct *command );
+} builtinEntry;
+
+/*----------------------------------------------------------------
+ * One alias: its name and the pre-tokenized replacement vector it
+ * splices into the args array. Tokens are heap copies owned by
+ * the table, so commands may borrow them across arena resets.
+ *--------------------------------------------------------------*/
+typedef struct aliasEntry
+{
+    char   *name;
+    char  **tokens;
+    int     numTokens;
+} aliasEntry;
+
+/* Per-stage latency accounting: log2 nanosecond buckets. */
+typedef struct statHistogram
+{
+    unsigned long       count;
+    unsigned long long  totalNs;
+    unsigned long       buckets[ STAT_NUM_BUCKETS ];
+} statHistogram;
 
 /*********************************************
  *           FUNCTION PROTOTYPES
@@ -38,10 +296,95 @@
 
 static int      AddChildPid
                     (
-                    pid_t              pid              /* The format string to print out   */
+                    pid_t               pid,            /* The pid to record                */
+                    const char         *name            /* The command name to cache        */
+                    );
+
+static int      AliasExpand
+                    (
+                    cmdStruct          *command         /* The freshly parsed command       */
+                    );
+
+static aliasEntry *AliasLookup
+                    (
+                    const char         *name            /* The command name to look up      */
+                    );
+
+static int      AliasSet
+                    (
+                    const char         *name,           /* The alias name to define         */
+                    char              **tokens,         /* The replacement token vector     */
+                    int                 numTokens       /* How many replacement tokens      */
+                    );
+
+static int      BatchInit
+                    (
+                    const char         *path            /* Script path, or NULL for stdin   */
+                    );
+
+static char    *BatchNextLine
+                    (
+                    void
+                    );
+
+static int      BuiltinInit
+                    (
+                    void
+                    );
+
+static builtinEntry *BuiltinLookup
+                    (
+                    const char         *name            /* The command name to look up      */
+                    );
+
+static int      ClientSend
+                    (
+                    const char         *sockPath,       /* The daemon's socket path         */
+                    int                 argCount,       /* Number of command words          */
+                    char              **argValues       /* The command words to send        */
+                    );
+
+static int      CommandSubst
+                    (
+                    char               *body,           /* The text inside $( )             */
+                    cmdStruct          *command,        /* The command receiving the words  */
+                    int                 argCount        /* Current argument count           */
+                    );
+
+static int      CompleteToken
+                    (
+                    char              **buf,            /* In/out: growable line buffer     */
+                    size_t             *cap,            /* In/out: capacity of the buffer   */
+                    size_t             *len             /* In/out: characters in the line   */
+                    );
+
+static int      DaemonServe
+                    (
+                    const char         *sockPath        /* Where to bind the socket         */
+                    );
+
+static int      DrainChildEvents
+                    (
+                    void
+                    );
+
+static int      EnvCacheReset
+                    (
+                    void
+                    );
+
+static char    *EnvLookup
+                    (
+                    const char         *name            /* The variable name to look up     */
+                    );
+
+static char    *ExpandVarRef
+                    (
+                    const char         *scan,           /* Cursor positioned at a '$'       */
+                    size_t             *refLen          /* Out: bytes the reference spans   */
                     );
 
-static char    *ExpandPID
+static char    *ExpandVars
                     (
                     char               *arg             /* The string to expand             */
                     );
@@ -51,6 +394,13 @@ static int      ExternalCommand
                     cmdStruct          *command         /* The command to run as a child    */
                     );
 
+static int      ForkCommand
+                    (
+                    cmdStruct          *command,        /* The command to run as a child    */
+                    char               *resolved,       /* Cached absolute path, or NULL    */
+                    pid_t              *pid             /* Out: pid of the forked child     */
+                    );
+
 static int      FreeArgs
                     (
                     cmdStruct          *command         /* The command whose args to free   */ 
@@ -58,13 +408,100 @@ static int      FreeArgs
 
 static int      GetInput
                     (
-                    char               *buf,            /* The buffer where to store input  */ 
-                    size_t              n               /* The size of the buffer           */ 
+                    char              **buf,            /* In/out: growable line buffer     */
+                    size_t             *n               /* In/out: capacity of the buffer   */
+                    );
+
+static int      GlobCompareName
+                    (
+                    const void         *a,              /* First name to compare            */
+                    const void         *b               /* Second name to compare           */
+                    );
+
+static int      GlobExpand
+                    (
+                    char               *pattern,        /* The glob pattern to expand       */
+                    cmdStruct          *command,        /* The command receiving matches    */
+                    int                 argCount        /* Current count of stored args     */
+                    );
+
+static bool     GlobMatch
+                    (
+                    const char         *pattern,        /* The pattern, with * and ?        */
+                    const char         *name            /* The file name to test            */
+                    );
+
+static globDirEntry *GlobScanDir
+                    (
+                    const char         *path            /* The directory to list            */
                     );
 
 static void     HandleSIGCHLD
                     (
-                    int                 signum          /* The signal number                */ 
+                    int                 signum          /* The signal number                */
+                    );
+
+static void     HandleSIGUSR1
+                    (
+                    int                 signum          /* The signal number                */
+                    );
+
+static unsigned long HashString
+                    (
+                    const char         *str             /* The string to hash               */
+                    );
+
+static int      HereStringFd
+                    (
+                    const char         *payload         /* The here-string body             */
+                    );
+
+static int      HistoryAppend
+                    (
+                    const char         *line            /* The command line to record       */
+                    );
+
+static char    *HistoryExpand
+                    (
+                    char               *line            /* The input line, maybe a recall   */
+                    );
+
+static int      HistoryLoad
+                    (
+                    void
+                    );
+
+static int      JobHashDelete
+                    (
+                    pid_t               pid             /* The pid to remove from the index */
+                    );
+
+static int      JobHashFind
+                    (
+                    pid_t               pid             /* The pid to look up               */
+                    );
+
+static int      JobHashInsert
+                    (
+                    pid_t               pid,            /* The pid to index                 */
+                    int                 slot            /* The job table slot it occupies   */
+                    );
+
+static int      JobHashRebuild
+                    (
+                    size_t              newSize         /* New index size (power of two)    */
+                    );
+
+static int      JobRecordAdd
+                    (
+                    pid_t               pid,            /* The pid that just finished       */
+                    int                 status,         /* Its raw wait status              */
+                    struct rusage      *usage           /* Its rusage captured by wait4     */
+                    );
+
+static int      JobTableGrow
+                    (
+                    void
                     );
 
 static void     HandleSIGTSTP
@@ -72,26 +509,129 @@ static void     HandleSIGTSTP
                     int                 signum          /* The signal number                */ 
                     );
 
+static int      MyAlias
+                    (
+                    cmdStruct          *command         /* The command containing alias     */
+                    );
+
 static int      MyChangeDir
                     (
                     cmdStruct          *command         /* The command containing the
-                                                            necessary info for CD            */ 
+                                                            necessary info for CD            */
                     );
                     
 static int      MyExit
                     (
-                    cmdStruct          *command         /* The command containing exit      */ 
+                    cmdStruct          *command         /* The command containing exit      */
+                    );
+
+static int      MyExport
+                    (
+                    cmdStruct          *command         /* The command containing export    */
+                    );
+
+static int      MyBg
+                    (
+                    cmdStruct          *command         /* The command containing bg        */
+                    );
+
+static int      MyFg
+                    (
+                    cmdStruct          *command         /* The command containing fg        */
+                    );
+
+static int      MyJobs
+                    (
+                    cmdStruct          *command         /* The command containing jobs      */
+                    );
+
+static int      MyStats
+                    (
+                    cmdStruct          *command         /* The command containing stats     */
                     );
 
 static int      MyStatus
                     (
-                    void
+                    cmdStruct          *command         /* The command containing status    */
                     );
 
 static int      ParseCommand
                     (
-                    char               *buf,            /* The buffer after user input rec'd*/ 
-                    cmdStruct          *command         /* The command struct to fill up    */ 
+                    char               *buf,            /* The buffer after user input rec'd*/
+                    cmdStruct          *command         /* The command struct to fill up    */
+                    );
+
+static int      PathCacheReset
+                    (
+                    void
+                    );
+
+static int      PathIndexCollect
+                    (
+                    void
+                    );
+
+static int      PathIndexEnsure
+                    (
+                    void
+                    );
+
+static size_t   PathIndexLower
+                    (
+                    const char         *prefix          /* The prefix to locate             */
+                    );
+
+static void    *PathIndexThreadFn
+                    (
+                    void               *arg             /* Unused thread argument           */
+                    );
+
+static int      PipelineCommand
+                    (
+                    cmdStruct          *command         /* The pipeline to run              */
+                    );
+
+static int      PromptFlush
+                    (
+                    void
+                    );
+
+static unsigned long long RcChecksum
+                    (
+                    const unsigned char *data,          /* The bytes to checksum            */
+                    size_t              len             /* How many bytes to fold in        */
+                    );
+
+static int      RcCompile
+                    (
+                    const char         *rcPath,         /* The textual rc source            */
+                    const char         *cachePath,      /* Where the compiled image goes    */
+                    cmdStruct          *command         /* Scratch command struct to reuse  */
+                    );
+
+static int      RcImagePut
+                    (
+                    const void         *data,           /* The bytes to append              */
+                    size_t              len             /* How many bytes to append         */
+                    );
+
+static int      RcLoad
+                    (
+                    cmdStruct          *command         /* Scratch command struct to reuse  */
+                    );
+
+static int      RcLoadCached
+                    (
+                    const char         *cachePath,      /* The compiled image to try        */
+                    const struct stat  *rcStat,         /* Fresh stat of the rc source      */
+                    cmdStruct          *command         /* Scratch command struct to reuse  */
+                    );
+
+static int      ReapReport
+                    (
+                    pid_t               pid,            /* The reaped child's pid           */
+                    int                 status,         /* Its raw wait status              */
+                    struct rusage      *usage           /* Its resource usage at exit       */
                     );
 
 static int      ReapZombies
@@ -101,12 +641,28 @@ static int      ReapZombies
 
 static int      RemoveChildPid
                     (
-                    pid_t               pid             /* The pid to remove from bg array  */ 
+                    pid_t               pid             /* The pid to remove from bg array  */
+                    );
+
+static int      ResetCommand
+                    (
+                    cmdStruct          *command         /* The command struct to reset      */
+                    );
+
+static char    *ResolvePath
+                    (
+                    char               *name            /* The command name to resolve      */
                     );
 
 static int      RunCommand
                     (
-                    cmdStruct          *command         /* The command to run               */ 
+                    cmdStruct          *command         /* The command to run               */
+                    );
+
+static int      RunCommandList
+                    (
+                    char               *line,           /* The full input line              */
+                    cmdStruct          *command         /* Scratch command struct to reuse  */
                     );
 
 static int      SetSignalHandlers
@@ -114,19 +670,170 @@ static int      SetSignalHandlers
                     void
                     );
 
+static int      SpawnCommand
+                    (
+                    cmdStruct          *command,        /* The command to run as a child    */
+                    char               *resolved,       /* Cached absolute path, or NULL    */
+                    pid_t              *pid             /* Out: pid of the spawned child    */
+                    );
+
+static void     StatsBegin
+                    (
+                    struct timespec    *start           /* Out: stage start timestamp      */
+                    );
+
+static void     StatsRecord
+                    (
+                    int                 stage,          /* Which stage completed            */
+                    struct timespec    *start           /* The stage's start timestamp      */
+                    );
+
+static char    *TokenNext
+                    (
+                    char               *buf             /* Line to tokenize, or NULL to
+                                                           continue the previous line       */
+                    );
+
 /*********************************************
  *            MODULE VARIABLES
  ********************************************/
 
-static pid_t                        childPids[ MAX_CHILDREN ];
+/*----------------------------------------------------------------
+ * Job table: a dynamically-sized slot array with an embedded free
+ * list, indexed by a pid-to-slot hash so insert and remove are O(1)
+ * no matter how many background jobs are in flight.
+ *--------------------------------------------------------------*/
+static jobSlot                     *jobTable                    = NULL;
+static size_t                       jobTableSize                = 0;
+static int                          jobFreeHead                 = -1;
+static size_t                       jobCount                    = 0;
+static jobHashEntry                *jobHash                     = NULL;
+static size_t                       jobHashSize                 = 0;
+static size_t                       jobHashTombstones           = 0;
+
+/* Rolling ring of finished-job records, newest overwriting oldest. */
+static jobRecord                    jobRing[ JOB_RING_SIZE ];
+static size_t                       jobRingNext                 = 0;
+static size_t                       jobRingCount                = 0;
+
+/* Cached directory listings for the glob engine, evicted round-robin. */
+static globDirEntry                 globCache[ GLOB_CACHE_SIZE ];
+static size_t                       globCacheNext               = 0;
+
+/*----------------------------------------------------------------
+ * History state: the in-memory ring of recent lines (slot i holds
+ * entry number i+1 modulo the ring size), and the mmap append
+ * window over the log file. Nothing is touched until the first
+ * command is recorded or recalled, so launch cost stays flat no
+ * matter how large the log has grown.
+ *--------------------------------------------------------------*/
+static char                        *histRing[ HIST_RING_SIZE ];
+static size_t                       histCount                   = 0;
+static bool                         histLoaded                  = FALSE;
+static int                          histFd                      = -1;
+static char                        *histMap                     = NULL;
+static size_t                       histMapSize                 = 0;
+static size_t                       histFileLen                 = 0;
+static size_t                       histDirty                   = 0;
+
 static int                          childStatus                 = 0;
+/* PATH resolution cache, built lazily as commands are launched. */
+static pathCacheEntry               pathCache[ PATH_CACHE_SIZE ];
+/* Copy of the PATH string the cache was built against. */
+static char                        *pathCacheEnv                = NULL;
+/* Number of occupied slots in the PATH resolution cache. */
+static size_t                       pathCacheCount              = 0;
+
+/* Sorted index of every PATH entry name, for tab completion. Built once on
+   a background thread at startup and rebuilt in place when PATH changes. */
+static char                       **pathIndex                   = NULL;
+static size_t                       pathIndexCount              = 0;
+static char                        *pathIndexEnv                = NULL;
+static pthread_t                    pathIndexThread;
+static bool                         pathIndexStarted            = FALSE;
+static bool                         pathIndexJoined             = FALSE;
+static bool                         pathIndexStale              = FALSE;
+
+/* Cache over getenv results, emptied when 'export' changes the
+   environment. Built lazily as variable references are expanded. */
+static envCacheEntry                envCache[ ENV_CACHE_SIZE ];
+static size_t                       envCacheCount               = 0;
+
+/* Scratch image the rc compiler serializes its records into. */
+static unsigned char               *rcImageBuf                  = NULL;
+static size_t                       rcImageLen                  = 0;
+static size_t                       rcImageCap                  = 0;
+static unsigned                     rcImageCmds                 = 0;
+
+/* Environment pointer passed to posix_spawn. */
+extern char                       **environ;
+
+/* Builtin dispatch table, populated once at startup. */
+static builtinEntry                 builtinTable[ BUILTIN_TABLE_SIZE ];
+
+/* Alias table, filled by the alias builtin (typically from the rc file). */
+static aliasEntry                   aliasTable[ ALIAS_TABLE_SIZE ];
+static size_t                       aliasCount                  = 0;
+
+/*----------------------------------------------------------------
+ * Command-list scheduler state: the concurrency cap for ';' member
+ * fan-out (0 keeps members sequential until SMALLSH_JOBS opts in),
+ * and the pid of the member a launch engine just started without
+ * waiting (so the scheduler can join it later).
+ *--------------------------------------------------------------*/
+static size_t                       schedMaxActive              = 0;
+static pid_t                        schedLastPid                = -1;
+
+/* Pid string for $$ expansion, computed once at startup. */
+static char                         shellPidStr[ 18 ];
+
+/* Per-stage latency histograms read by the stats builtin. */
+static statHistogram                statHistograms[ STAT_NUM_STAGES ];
+static const char                  *statStageNames[ STAT_NUM_STAGES ] =
+{
+    "GetInput",
+    "ParseCommand",
+    "RunCommand",
+    "FreeArgs",
+    "launch",
+    "fg-reap",
+};
+
+/* Resume point of the tokenizer within the current input line. */
+static char                        *tokenCursor                 = NULL;
+
+/* Batch (non-interactive) script input state. */
+static bool                         batchMode                   = FALSE;
+static char                        *batchBuf                    = NULL;
+static size_t                       batchLen                    = 0;
+static size_t                       batchPos                    = 0;
+/*----------------------------------------------------------------
+ * Self-pipe written by the SIGCHLD handler. The input wait polls
+ * its read end alongside stdin so zombies are reaped the moment
+ * they appear, even while blocked at the prompt.
+ *--------------------------------------------------------------*/
+static int                          sigChldPipe[ 2 ]            = { -1, -1 };
 /* flags used by signal handlers */
 static volatile sig_atomic_t        backgroundIgnoreSet         = FALSE;
 static volatile sig_atomic_t        backgroundUnignoreSet       = FALSE;
-static volatile sig_atomic_t        childTerminated             = FALSE;
 static volatile sig_atomic_t        foregroundChild             = FALSE;
 static volatile sig_atomic_t        ignoreBackground            = FALSE;
 
+/*----------------------------------------------------------------
+ * Single-producer ring of child-exit events. The SIGCHLD handler
+ * reaps with WNOHANG and pushes records at head; ReapZombies
+ * consumes them at tail. Each index has exactly one writer, so no
+ * lock is needed. While reapHold (or a foreground wait) is up the
+ * handler leaves zombies alone and sets chldDeferred instead, so
+ * the targeted wait4 calls in the command engines never lose a
+ * child to the handler.
+ *--------------------------------------------------------------*/
+static chldEvent                    chldRing[ CHLD_RING_SIZE ];
+static volatile sig_atomic_t        chldRingHead                = 0;
+static volatile sig_atomic_t        chldRingTail                = 0;
+static volatile sig_atomic_t        chldDeferred                = FALSE;
+static volatile sig_atomic_t        reapHold                    = FALSE;
+
 /*********************************************
  *               FUNCTIONS
  ********************************************/
@@ -142,853 +849,5698 @@ static volatile sig_atomic_t        ignoreBackground            = FALSE;
  *      resets the command data structures, gets new user input, parses the
  *      input, runs the command, and then checks for any zombie child
  *      processes.
- *  
+ *
+ *      When a script path is given as an argument, or when stdin is not a
+ *      terminal, the shell runs in batch mode: the whole script is loaded
+ *      up front, line boundaries are scanned in place with no per-line
+ *      copying, and the prompt is suppressed. The shell exits when the
+ *      script is exhausted.
+ *
  ****************************************************************************/
 
-int main(void)
+int main
+    (
+    int                 argc,           /* Number of command line arguments */
+    char               *argv[]          /* Command line argument values     */
+    )
 {
     /******************************
     *  LOCAL VARIABLES
     ******************************/
-    char            buf[ BUF_SIZE ];
+    size_t          bufCap;
+    char           *lp_buf;
+    char           *lp_jobsEnv;
+    char           *lp_line;
     cmdStruct       newCmd;
+    struct timespec stageStart;
 
-    /* Install signal handlers */
-    SetSignalHandlers();
+    /******************************
+    *  INITIALIZE VARIABLES
+    ******************************/
+    bufCap      = 0;
+    lp_buf      = NULL;
 
-    for(;;)
+    /* Client mode needs no shell machinery at all; bail out early. */
+    if( argc > 2 && strcmp( argv[ 1 ], CLIENT_FLAG ) == 0 )
     {
-        /* Clear out previous command */
-        memset( &newCmd, 0, sizeof( newCmd ) );
-        memset( buf, '\0', sizeof( buf ) );
+        exit( ClientSend( argv[ 2 ], argc - 3, &argv[ 3 ] ) );
+    }
 
-        /* Read input */
-        GetInput( buf, sizeof( buf ) );
+    /* Install signal handlers */
+    SetSignalHandlers();
 
-        /* Process input */
-        ParseCommand( buf, &newCmd );
+    /* Start the trace drain thread if SMALLSH_TRACE names a file. */
+    UTL_TraceInit();
 
-        /* Run command */
-        RunCommand( &newCmd );
+    /*----------------------------------------------------------------
+     * Zero the command struct once; after this, ResetCommand clears
+     * only the slots each command actually used.
+     *--------------------------------------------------------------*/
+    memset( &newCmd, 0, sizeof( newCmd ) );
+    /* Zero is a real fd; the empty here-string slot is -1. */
+    newCmd.hereFd = -1;
 
-        /* Free args */
-        FreeArgs( &newCmd );
+    /* Compute the pid string once; ExpandVars splices it into tokens. */
+    snprintf( shellPidStr, sizeof( shellPidStr ), "%d", getpid() );
 
-        /* Clean up dead children. This flag is set by the SIGCHLD handler. */
-        if( childTerminated == TRUE )
+    /* Populate the builtin dispatch table. */
+    BuiltinInit();
+
+    /*----------------------------------------------------------------
+     * ';' list fan-out is opt-in: members run strictly in order
+     * unless SMALLSH_JOBS is set, since dependent chains like
+     * 'a > f ; cat f' cannot be told apart from independent ones.
+     * The value sets the concurrency cap; anything unusable falls
+     * back to the default cap.
+     *--------------------------------------------------------------*/
+    lp_jobsEnv = getenv( JOBS_ENV );
+    if( lp_jobsEnv != NULL )
+    {
+        schedMaxActive = ( atoi( lp_jobsEnv ) > 0 )
+                       ? (size_t)atoi( lp_jobsEnv )
+                       : SCHED_DEFAULT_ACTIVE;
+        if( schedMaxActive > SCHED_MAX_ACTIVE )
         {
-            ReapZombies();
+            schedMaxActive = SCHED_MAX_ACTIVE;
         }
     }
 
-    exit( EXIT_SUCCESS );
-
-} /* end - main() */
-
-
-/*****************************************************************************
- *
- * NAME
- *      AddChildPid
- *
- * DESCRIPTION
- *      This function adds the given pid to the static array of child pids.
- *
- * NOTES
- *      Assumes a statically-allocated array of size MAX_CHILDREN.
- *  
- ****************************************************************************/
+    /* Source ~/.smallshrc, through its compiled cache when still fresh. */
+    RcLoad( &newCmd );
 
-static int AddChildPid
-    (
-    pid_t              pid              /* The format string to print out   */
-    )
-{
-    /*-------------------------------------------------------------
-     * Find the first empty entry in the child pids array and store
-     * the given pid there.
-     *-----------------------------------------------------------*/
-    for( size_t i = 0; i < MAX_CHILDREN; i++ )
+    /* Daemon mode serves command lines over a unix socket instead. */
+    if( argc > 2 && strcmp( argv[ 1 ], DAEMON_FLAG ) == 0 )
     {
-        if( childPids[ i ] == 0 )
-        {
-            UTL_DebugPrint( "Adding pid %d\n", pid );
-            childPids[ i ] = pid;
-            break;
-        }
+        DaemonServe( argv[ 2 ] );
     }
 
-    return( EXIT_SUCCESS );
-}
+    /*----------------------------------------------------------------
+     * Enter batch mode when driven by a script file argument or a
+     * non-terminal stdin (pipe or file redirection).
+     *--------------------------------------------------------------*/
+    if( argc > 1 )
+    {
+        BatchInit( argv[ 1 ] );
+    }
+    else if( !isatty( STDIN_FILENO ) )
+    {
+        BatchInit( NULL );
+    }
+
+    /*----------------------------------------------------------------
+     * Interactive sessions get tab completion; start indexing PATH on
+     * a background thread so the first Tab finds it already built.
+     *--------------------------------------------------------------*/
+    if( batchMode == FALSE )
+    {
+        if( pthread_create( &pathIndexThread, NULL, PathIndexThreadFn, NULL ) == 0 )
+        {
+            pathIndexStarted = TRUE;
+        }
+    }
+
+    for(;;)
+    {
+        /* Clear out previous command, touching only the slots it used. */
+        ResetCommand( &newCmd );
+
+        /* Read input */
+        StatsBegin( &stageStart );
+        if( batchMode == TRUE )
+        {
+            /* Next line straight out of the loaded script buffer. */
+            lp_line = BatchNextLine();
+            /* Script exhausted; batch runs end at end of input. */
+            if( lp_line == NULL )
+            {
+                break;
+            }
+        }
+        else
+        {
+            GetInput( &lp_buf, &bufCap );
+            lp_line = lp_buf;
+            /* Expand any !!/!n recall, then record the line that runs. */
+            lp_line = HistoryExpand( lp_line );
+            HistoryAppend( lp_line );
+        }
+        StatsRecord( STAT_STAGE_GETINPUT, &stageStart );
+
+        /* Parse and run every member of the command list. */
+        RunCommandList( lp_line, &newCmd );
+
+        /* Free args */
+        StatsBegin( &stageStart );
+        FreeArgs( &newCmd );
+        StatsRecord( STAT_STAGE_FREE, &stageStart );
+
+        /*---------------------------------------------------------------
+         * Clean up any children that died while the command ran. While
+         * blocked at the interactive prompt, GetInput's poll loop reaps
+         * with no added latency; this covers the batch path and exits
+         * that raced the last command.
+         *-------------------------------------------------------------*/
+        DrainChildEvents();
+
+        /*---------------------------------------------------------------
+         * End of iteration is a safe point: emit whatever the reap just
+         * queued. Free when nothing was queued, and in batch mode this
+         * is the only spot notices get out before the next command.
+         *-------------------------------------------------------------*/
+        UTL_FlushOutput();
+    }
+
+    exit( EXIT_SUCCESS );
+
+} /* end - main() */
 
 
 /*****************************************************************************
  *
  * NAME
- *      ExpandPID
+ *      AddChildPid
  *
  * DESCRIPTION
- *      Given a pointer to a string, this function will heap-allocate space
- *      for a new string in which all instances of the '$$' variable has been
- *      expanded to the current process's pid.
+ *      This function records the given pid in the job table along with its
+ *      start timestamp and command name. A slot is popped off the free
+ *      list (growing the table when none remain) and the pid-to-slot hash
+ *      index is updated, so insertion is O(1) regardless of how many jobs
+ *      are being tracked.
  *
- * NOTES
- *      The memory returned by this function must be freed by the caller.     
- *  
  ****************************************************************************/
 
-static char *ExpandPID
+static int AddChildPid
     (
-    char               *arg             /* The string to expand             */
+    pid_t               pid,            /* The pid to record                */
+    const char         *name            /* The command name to cache        */
     )
 {
     /******************************
     *  LOCAL VARIABLES
     ******************************/
-    size_t      argIdx;
-    long        n;
-    char       *lp_newArg;
-    size_t      newArgIdx;
-    pid_t       pid;
-    char        pidStr[18];
-    long        pidLen;
-
-    /******************************
-    *  INITIALIZE VARIABLES
-    ******************************/
-    argIdx      = 0;
-    n           = strlen( arg );
-    newArgIdx   = 0;
-    pid         = getpid();
-    /* Convert pid into string */
-    snprintf( pidStr, sizeof( pidStr ), "%d", pid );
-    pidLen      = strlen( pidStr );
+    int         slot;
 
-    /*----------------------------------------------------------------
-     * Allocate maximum possible memory, equal to number of times $$
-     * can show up in the argument string. Initialize to 0's to
-     * implicitly add NULL terminator to end of new argument string.
-     *--------------------------------------------------------------*/
-    lp_newArg   = calloc( ( n / 2 ) * pidLen + 1, sizeof( char ) );
-    if( lp_newArg == NULL )
+    /* Grow the table when the free list is empty. */
+    if( jobFreeHead == -1 )
     {
-        fprintf( stderr, "Failed to allocate space for arg %s\n", arg );
-        exit( EXIT_FAILURE );
+        JobTableGrow();
     }
 
-    UTL_DebugPrint( "lp_newArg: %x\n", lp_newArg );
-    
-    /*-----------------------------------------------------------------
-     * Loop until end of current argument. Strtok adds NULL terminator
-     * to end of token, so guaranteed to hit '\0'.
-     *---------------------------------------------------------------*/
-    while( arg[argIdx] != '\0' )
-    {
-        UTL_DebugPrint( "argIdx and argIdx+1: %c\t%c\n", arg[argIdx], arg[argIdx+1] );
-        if( arg[argIdx] == '$' && arg[argIdx+1] == '$' )
-        {
-            /* Replace pid variables with pid string */
-            strncat( lp_newArg, pidStr, pidLen );
-            /* Skip forward 1 extra spot to pass second $ */
-            argIdx += 1;
-            /*---------------------------------------------------
-             * Skip forward in new string by size of pid string,
-             * excluding NULL terminator.
-             *-------------------------------------------------*/
-            newArgIdx += pidLen;
-        }
-        else
-        {
-            /* Copy non-pid variables to new string */
-            lp_newArg[newArgIdx] = arg[argIdx];
-            newArgIdx += 1;
-        }
-
-        /* Update loop counter for next iteration */
-        argIdx += 1;
-    }
+    /* Pop a slot off the free list and store the pid there. */
+    slot        = jobFreeHead;
+    jobFreeHead = jobTable[ slot ].nextFree;
 
-    UTL_DebugPrint( " new arg: %s\n", lp_newArg );
+    UTL_DebugPrint( "Adding pid %d in slot %d\n", pid, slot );
+    jobTable[ slot ].pid = pid;
+    clock_gettime( CLOCK_MONOTONIC, &jobTable[ slot ].start );
+    snprintf( jobTable[ slot ].name, JOB_NAME_LEN, "%s", ( name != NULL ) ? name : "" );
+    jobCount += 1;
 
-    return( lp_newArg );
+    /* Index the pid for O(1) removal. */
+    JobHashInsert( pid, slot );
 
-} /* end - ExpandPID() */
+    return( EXIT_SUCCESS );
+}
 
 
 /*****************************************************************************
  *
  * NAME
- *      ExternalCommand
+ *      AliasExpand
  *
  * DESCRIPTION
- *      This function forks a child process, sets it up according to the
- *      specification of the command struct, and then calls exec() on the
- *      given external (non-built-in) command. If exec fails, the child
- *      process will exit with an exit status. The parent process will either
- *      wait for the child to terminate (foreground) or store the child's pid
- *      and continue on to processing the next command (background).
- *  
+ *      This function splices the alias for a freshly parsed command's name,
+ *      if one exists, into its args array. Only the command-name position
+ *      (args[0]) is checked, so the per-token hot path through the parser
+ *      pays nothing; an unaliased name - the common case - costs one table
+ *      probe landing on an empty slot. Expansion shifts the existing
+ *      arguments once and memcpys the pre-tokenized replacement vector
+ *      into place; no re-parse runs, and dispatch sees the alias fully
+ *      resolved.
+ *
+ * NOTES
+ *      Expansion is single-level: an alias body's command name is not
+ *      itself alias-expanded, which also makes self-reference safe.
+ *
  ****************************************************************************/
 
-static int ExternalCommand
+static int AliasExpand
     (
-    cmdStruct          *command         /* The command to run as a child    */
+    cmdStruct          *command         /* The freshly parsed command       */
     )
 {
     /******************************
     *  LOCAL VARIABLES
     ******************************/
-    int         inputFd;
-    int         outputFd;
-    
-    /******************************
-    *  INITIALIZE VARIABLES
-    ******************************/
-    inputFd     = -1;
-    outputFd    = -1;
+    int         delta;
+    aliasEntry *lp_alias;
 
-    pid_t pid = fork();
-
-    switch( pid )
+    if( command->argCount == 0 || command->args[ 0 ] == NULL )
     {
-        /* Could not create child process */
-        case -1:
-            fprintf( stderr, "Failed to fork child process\n" );
-            break;
-        /* Child process drops in here */
-        case 0:
-            UTL_DebugPrint( "Child Process: %d\n", pid );
-
-            /* Reset SIGCHLD to default handler */
-            struct sigaction SIGCHLD_action = {0};
-            SIGCHLD_action.sa_handler = SIG_DFL;
-            sigaction( SIGCHLD, &SIGCHLD_action, NULL );
-            
-            /* Ignore SIGTSTP signals */
-            struct sigaction SIGTSTP_action = {0};
-            SIGTSTP_action.sa_handler = SIG_IGN;
-            sigaction( SIGTSTP, &SIGTSTP_action, NULL );
-
-            /* Handle redirects */
-            if( command->isRedirectOutput == TRUE )
-            {
-                UTL_DebugPrint( "Redirecting stdout to %s\n", command->output );
-                outputFd = OPEN_FILE_WRITE( command->output );
-                dup2( outputFd, STDOUT_FILENO );
-            }
-            if( command->isRedirectInput == TRUE )
-            {
-                UTL_DebugPrint( "Redirecting stdin from %s\n", command->input );
-                inputFd = OPEN_FILE_READ( command->input );
-                dup2( inputFd, STDIN_FILENO );
-            }
-            /* Stop ignoring SIGINT for foreground processes */
-            if( command->isBackground == FALSE )
-            {
-                struct sigaction SIGINT_action = {0};
-                SIGINT_action.sa_handler = SIG_DFL;
-                sigaction( SIGINT, &SIGINT_action, NULL );
-            }
-            /*--------------------------------------------------------------- 
-             * Background processes that aren't otherwise redirecting their
-             * inputs or outputs will have their inputs/outputs redirected
-             * from/to dev/null, respectively.
-             *-------------------------------------------------------------*/
-            else
-            {
-                if( command->isRedirectOutput == FALSE )
-                {
-                    outputFd = OPEN_FILE_WRITE( DEV_NULL );
-                    dup2( outputFd, STDOUT_FILENO );
-                }
-                if( command->isRedirectInput == FALSE )
-                {
-                    inputFd = OPEN_FILE_READ( DEV_NULL );
-                    dup2( inputFd, STDIN_FILENO );
-                }
-            }
-            
-            /* exec only returns if it fails. Report failure, clean up, and exit. */
-            if( execvp( command->args[0], command->args ) == -1 )
-            {
-                UTL_FlushedPrintOut( "%s: no such file or directory\n", command->args[0] );
-            }
-
-            /* Close open file descriptors */
-            if( outputFd != -1 )
-            {
-                close( outputFd );
-            }
-            if( inputFd != -1 )
-            {
-                close( inputFd );
-            }
+        return( EXIT_SUCCESS );
+    }
 
-            exit( EXIT_FAILURE );
-            break;
-        /* Parent process drops in here */
-        default:
-            UTL_DebugPrint( "Parent Process: %d\n", pid );
+    lp_alias = AliasLookup( command->args[ 0 ] );
+    if( lp_alias == NULL )
+    {
+        return( EXIT_SUCCESS );
+    }
 
-            /* Add child to list of child pids. */
-            AddChildPid( pid );
+    /* Too long to expand; run the name unaliased rather than truncate. */
+    delta = lp_alias->numTokens - 1;
+    if( command->argCount + delta > MAX_ARGS )
+    {
+        return( EXIT_FAILURE );
+    }
 
-            /* Wait and block until foreground process completes. */
-            if( command->isBackground == FALSE )
-            {
-                /*----------------------------------------------------------------- 
-                 * If SIGTSTP signal arrives while waiting for foreground process,
-                 * need to know to print out message that we're changed FG/BG modes
-                 * before next user input. This flag is used by the SIGTSTP handler
-                 * to make that determination.
-                 *---------------------------------------------------------------*/
-                foregroundChild = TRUE;
-                waitpid( pid, &childStatus, 0 );
-                /* Remove child pid from pids array. */
-                RemoveChildPid( pid );
-                foregroundChild = FALSE;
-
-                /* If child was terminated by a signal, display the signal to the user. */
-                if( WIFSIGNALED( childStatus ) )
-                {
-                    UTL_FlushedPrintOut( "terminated by signal %d\n", WTERMSIG( childStatus ) );
-                }
-                /* If a child terminated normally with a non-0 status, get that status. */
-                else if( childStatus != 0 )
-                {
-                    childStatus = WIFEXITED( childStatus );
-                }
-            }
-            /* Inform user of background process's pid. */
-            else
-            {
-                UTL_FlushedPrintOut( "background pid is %d\n", pid );
-            }
-            break;
+    /* One shift for the old arguments, one memcpy for the new head. */
+    if( delta != 0 )
+    {
+        memmove( &command->args[ 1 + delta ], &command->args[ 1 ],
+                 ( command->argCount - 1 ) * sizeof( char * ) );
+        for( int s = 1; s < command->numStages; s++ )
+        {
+            command->stageStart[ s ] += delta;
+        }
     }
+    memcpy( &command->args[ 0 ], lp_alias->tokens,
+            lp_alias->numTokens * sizeof( char * ) );
+    command->argCount += delta;
 
     return( EXIT_SUCCESS );
 
-} /* end - ExternalCommand() */
+} /* end - AliasExpand() */
 
 
 /*****************************************************************************
  *
  * NAME
- *      FreeArgs
+ *      AliasLookup
  *
  * DESCRIPTION
- *      This function frees all of the heap-allocated memory stored in the
- *      arguments array of a command struct.
+ *      This function looks a command name up in the alias table. Like the
+ *      builtin table, it is kept sparse enough that a non-alias fails its
+ *      lookup on the first probe in practice.
  *
  * NOTES
- *      Assumes that the arguments array is a statically-allocated array of
- *      size MAX_ARGS.
- *  
+ *      Returns NULL when the name has no alias.
+ *
  ****************************************************************************/
 
-static int FreeArgs
+static aliasEntry *AliasLookup
     (
-    cmdStruct          *command         /* The command whose args to free   */ 
+    const char         *name            /* The command name to look up      */
     )
 {
-    /* Loop through command's args array and free each one. */
-    for( size_t i = 0; i < MAX_ARGS; i++ )
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    size_t      idx;
+
+    /* Probe until the name or an empty slot is found. */
+    idx = HashString( name ) & ( ALIAS_TABLE_SIZE - 1 );
+    while( aliasTable[ idx ].name != NULL )
     {
-        /* Skip NULLS. */
-        if( command->args[ i ] != NULL )
+        if( strcmp( aliasTable[ idx ].name, name ) == 0 )
         {
-            UTL_DebugPrint( "Freeing %s\n", command->args[ i ] );
-            free( command->args[ i ] );
+            return( &aliasTable[ idx ] );
         }
+        idx = ( idx + 1 ) & ( ALIAS_TABLE_SIZE - 1 );
     }
 
-    return( EXIT_SUCCESS );
+    return( NULL );
 
-} /* end - FreeArgs() */
+} /* end - AliasLookup() */
 
 
 /*****************************************************************************
  *
  * NAME
- *      GetInput
+ *      AliasSet
  *
  * DESCRIPTION
- *      This function prompts the user for input using fgets().
+ *      This function defines or redefines an alias. The replacement tokens
+ *      are deep-copied onto the heap so they outlive the per-command arena
+ *      the originals were parsed into; redefinition frees the old vector
+ *      in place.
  *
- * NOTES
- *      Any trailing newline is not removed from the string captured in this
- *      function.
- *  
  ****************************************************************************/
 
-static int GetInput
+static int AliasSet
     (
-    char               *buf,            /* The buffer where to store input  */ 
-    size_t              n               /* The size of the buffer           */ 
+    const char         *name,           /* The alias name to define         */
+    char              **tokens,         /* The replacement token vector     */
+    int                 numTokens       /* How many replacement tokens      */
     )
 {
-    /*-----------------------------------------------------------------------
-     * Print informative messages to user when SIGTSTP signal is dispatched
-     * while a foreground process is running as soon as said process ends.
-     *---------------------------------------------------------------------*/
-    if( backgroundIgnoreSet )
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    size_t      idx;
+    char      **lp_copy;
+
+    /* Deep-copy the replacement vector before touching the table. */
+    lp_copy = malloc( numTokens * sizeof( char * ) );
+    for( int i = 0; i < numTokens; i++ )
     {
-        UTL_FlushedPrintOut( "\nEntering foreground-only mode (& is now ignored)\n" );
-        backgroundIgnoreSet = FALSE;
+        lp_copy[ i ] = strdup( tokens[ i ] );
     }
-    else if( backgroundUnignoreSet )
+
+    /* Probe for the name or the empty slot it will occupy. */
+    idx = HashString( name ) & ( ALIAS_TABLE_SIZE - 1 );
+    while( aliasTable[ idx ].name != NULL )
     {
-        UTL_FlushedPrintOut( "\nExiting foreground-only mode\n" );
-        backgroundUnignoreSet = FALSE;
+        if( strcmp( aliasTable[ idx ].name, name ) == 0 )
+        {
+            /* Redefinition: swap the vectors, keep the name. */
+            for( int i = 0; i < aliasTable[ idx ].numTokens; i++ )
+            {
+                free( aliasTable[ idx ].tokens[ i ] );
+            }
+            free( aliasTable[ idx ].tokens );
+            aliasTable[ idx ].tokens    = lp_copy;
+            aliasTable[ idx ].numTokens = numTokens;
+            return( EXIT_SUCCESS );
+        }
+        idx = ( idx + 1 ) & ( ALIAS_TABLE_SIZE - 1 );
     }
 
-    /* Print user input prompt. */
-    UTL_FlushedPrintOut( ": " );
-    /* Read line from stdin */
-    fgets( buf, n, stdin );
+    /* Keep the table sparse so misses stay single-probe. */
+    if( aliasCount >= ALIAS_TABLE_SIZE / 2 )
+    {
+        for( int i = 0; i < numTokens; i++ )
+        {
+            free( lp_copy[ i ] );
+        }
+        free( lp_copy );
+        UTL_FlushedPrintOut( "alias: table full\n" );
+        return( EXIT_FAILURE );
+    }
+
+    aliasTable[ idx ].name      = strdup( name );
+    aliasTable[ idx ].tokens    = lp_copy;
+    aliasTable[ idx ].numTokens = numTokens;
+    aliasCount += 1;
 
     return( EXIT_SUCCESS );
 
-} /* end - GetInput() */
+} /* end - AliasSet() */
 
 
 /*****************************************************************************
  *
  * NAME
- *      HandleSIGCHLD
+ *      BatchInit
  *
  * DESCRIPTION
- *      This is the signal handler for SIGCHLD signals for the parent process.
- *      It sets a global flag whenever a child process terminates. The flag
- *      is checked in main() and if set the parent process will reap any
- *      zombie child processes.
- *  
+ *      This function loads the batch script into memory in one pass.
+ *      Regular files are memory-mapped copy-on-write so line scanning can
+ *      NUL-terminate in place without touching the file; pipes and other
+ *      non-seekable inputs are slurped with large block reads into a
+ *      growable buffer. Either way, the main loop afterwards consumes
+ *      lines with zero per-line syscalls and zero copies.
+ *
  ****************************************************************************/
 
-static void HandleSIGCHLD
+static int BatchInit
     (
-    int                 signum          /* The signal number                */ 
+    const char         *path            /* Script path, or NULL for stdin   */
     )
 {
-    /* Set flag that will be checked at the end of each loop in main. */
-    childTerminated = TRUE;
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    size_t      cap;
+    int         fd;
+    ssize_t     nRead;
+    struct stat scriptStat;
 
-    /* Appease compiler warning. */
-    if( signum )
+    /******************************
+    *  INITIALIZE VARIABLES
+    ******************************/
+    fd          = STDIN_FILENO;
+
+    /* Open the script file when one was given. */
+    if( path != NULL )
     {
-        ;
+        fd = OPEN_FILE_READ( path );
     }
-} /* end - HandleSIGCHLD() */
-
 
-/*****************************************************************************
- *
- * NAME
- *      HandleSIGTSTP
- *
- * DESCRIPTION
- *      This is the signal handler for SIGTSTP. It checks whether we are
- *      currently in background-only mode before toggling the mode. It also
- *      checks whether we are currently waiting for a foreground child
- *      process to finish, in which case a flag is set so that the user is
- *      prompted of the mode change the next time the user is prompted for
- *      input.
- *  
- ****************************************************************************/
-
-static void HandleSIGTSTP
-    (
-    int                 signum          /* The signal number                */ 
-    )
-{
-    /* Currently in background mode. Set to foreground mode and tell user. */
-    if( ignoreBackground == FALSE )
+    /*----------------------------------------------------------------
+     * Map regular files copy-on-write: no read syscalls at all, and
+     * the private mapping lets the tokenizer write NUL terminators
+     * into the buffer without dirtying the file.
+     *--------------------------------------------------------------*/
+    if( fstat( fd, &scriptStat ) == 0 && S_ISREG( scriptStat.st_mode )
+     && scriptStat.st_size > 0 )
     {
-        ignoreBackground = TRUE;
-
-        /*-----------------------------------------------------
-         * Currently waiting on foreground proces to complete.
-         * Delay message until next user prompt.
-         *---------------------------------------------------*/
-        if( foregroundChild == TRUE )
-        {
-            backgroundIgnoreSet = TRUE;
-        }
-        else
+        batchBuf = mmap( NULL, scriptStat.st_size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE, fd, 0 );
+        if( batchBuf != MAP_FAILED )
         {
-            write( STDOUT_FILENO, "\nEntering foreground-only mode (& is now ignored)\n: ", 52 );
+            batchLen    = scriptStat.st_size;
+            batchMode   = TRUE;
+
+            return( EXIT_SUCCESS );
         }
+        batchBuf = NULL;
     }
-    /* Currently in foreground mode. Set to background mode and tell user. */
-    else
+
+    /*----------------------------------------------------------------
+     * Pipe or mmap failure: slurp the whole input with block reads
+     * into a geometrically-grown buffer.
+     *--------------------------------------------------------------*/
+    cap      = BATCH_CHUNK_SIZE;
+    batchBuf = malloc( cap );
+    if( batchBuf == NULL )
     {
-        ignoreBackground = FALSE;
+        fprintf( stderr, "Failed to allocate batch input buffer\n" );
+        exit( EXIT_FAILURE );
+    }
 
-        /*-----------------------------------------------------
-         * Currently waiting on foreground proces to complete.
-         * Delay message until next user prompt.
-         *---------------------------------------------------*/
-        if( foregroundChild == TRUE )
+    for(;;)
+    {
+        /* Grow the buffer when less than a full chunk remains. */
+        if( cap - batchLen < BATCH_CHUNK_SIZE )
         {
-            backgroundUnignoreSet = TRUE;
+            cap *= 2;
+            batchBuf = realloc( batchBuf, cap );
+            if( batchBuf == NULL )
+            {
+                fprintf( stderr, "Failed to grow batch input buffer\n" );
+                exit( EXIT_FAILURE );
+            }
         }
-        else
+
+        nRead = read( fd, batchBuf + batchLen, BATCH_CHUNK_SIZE );
+        if( nRead <= 0 )
         {
-            write( STDOUT_FILENO, "\nExiting foreground-only mode\n: ", 32 );
+            break;
         }
-       
+        batchLen += nRead;
     }
 
-    /* Appease compiler warning. */
-    if( signum )
+    if( path != NULL )
     {
-        ;
+        close( fd );
     }
 
-} /* end - HandleSIGTSTP() */
+    batchMode = TRUE;
+
+    return( EXIT_SUCCESS );
+
+} /* end - BatchInit() */
+
 
 /*****************************************************************************
  *
  * NAME
- *      MyChangeDir
+ *      BatchNextLine
  *
  * DESCRIPTION
- *      This function performs the built-in 'cd' command. If no argument is
- *      supplied, this will change the current directory to the vlaue of the
- *      HOME environment variable. Otherwise, it will attempt to change the
- *      directory to the supplied argument.
- *  
+ *      This function returns the next line of the loaded batch script,
+ *      NUL-terminated in place inside the script buffer. No copying is
+ *      done; the returned pointer remains valid until the next call.
+ *
+ * NOTES
+ *      Returns NULL once the script is exhausted.
+ *
  ****************************************************************************/
 
-static int MyChangeDir
-    (
-    cmdStruct          *command         /* The command containing the
-                                           necessary info for CD            */ 
-    )
+static char *BatchNextLine(void)
 {
-    /* No directory given, use HOME environment variable instead. */
-    if( command-> args[ 1 ] == NULL )
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    char       *lp_line;
+    char       *lp_newline;
+
+    /* Script exhausted. */
+    if( batchPos >= batchLen )
     {
-        if( chdir( getenv( HOME_ENV ) ) == -1 )
-        {
-            fprintf( stderr, "Failed to change directory to HOME environment variable.\n" );
-        }
+        return( NULL );
     }
-    /* Attempt to CD to directory provided. */
-    else if( chdir( command->args[ 1 ] ) == -1 )
+
+    lp_line     = batchBuf + batchPos;
+    lp_newline  = UTL_ScanByteN( lp_line, '\n', batchLen - batchPos );
+
+    /* Terminate the line in place and step past it. */
+    if( lp_newline != NULL )
     {
-        UTL_FlushedPrintOut( "Invalid path %s\n", command->args[ 1 ] );
+        *lp_newline = '\0';
+        batchPos    = ( lp_newline - batchBuf ) + 1;
+    }
+    else
+    {
+        /*---------------------------------------------------------------
+         * Final line has no trailing newline. Copy it into a stable
+         * NUL-terminated arena string, since writing one past the end
+         * of the mapping would fault.
+         *-------------------------------------------------------------*/
+        size_t tailLen = batchLen - batchPos;
+        char *lp_tail  = UTL_ArenaAlloc( tailLen + 1 );
+        memcpy( lp_tail, lp_line, tailLen );
+        batchPos = batchLen;
+        lp_line  = lp_tail;
     }
 
-    return( EXIT_SUCCESS );
+    return( lp_line );
 
-} /* end - MyChangeDir() */
+} /* end - BatchNextLine() */
 
 
 /*****************************************************************************
  *
  * NAME
- *      MyExit
+ *      BuiltinInit
  *
  * DESCRIPTION
- *      This function performs the built-in 'exit' command. It will free all
- *      heap-allocated memory for the current command, terminate all open
- *      child processes, and then exit.
- *  
+ *      This function populates the builtin dispatch table once at startup.
+ *      Entries are placed by name hash with linear probing; the table is
+ *      sparse enough that lookups resolve in a single probe in practice.
+ *
  ****************************************************************************/
 
-static int MyExit
-    (
-    cmdStruct          *command         /* The command containing exit      */ 
-    )
+static int BuiltinInit(void)
 {
-    /* Free all args in the command struct. */
-    FreeArgs( command );
-
-    /* Terminate all ongoing child processes. */
-    for( size_t i = 0; i < MAX_CHILDREN; i++ )
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    static const builtinEntry   builtins[] =
     {
-        if( childPids[ i ] != 0 )
+        { CD_CMD,     MyChangeDir },
+        { EXIT_CMD,   MyExit      },
+        { STATUS_CMD, MyStatus    },
+        { STATS_CMD,  MyStats     },
+        { JOBS_CMD,   MyJobs      },
+        { EXPORT_CMD, MyExport    },
+        { ALIAS_CMD,  MyAlias     },
+        { FG_CMD,     MyFg        },
+        { BG_CMD,     MyBg        },
+    };
+    size_t                      idx;
+
+    /* Hash each builtin into the dispatch table. */
+    for( size_t i = 0; i < sizeof( builtins ) / sizeof( builtins[ 0 ] ); i++ )
+    {
+        idx = HashString( builtins[ i ].name ) & ( BUILTIN_TABLE_SIZE - 1 );
+        while( builtinTable[ idx ].name != NULL )
         {
-            /* Send signal to terminate child. */
-            kill( childPids[ i ], SIGTERM );
-            /* Wait for child to terminate. */
-            waitpid( childPids[ i ], &childStatus, 0 );
+            idx = ( idx + 1 ) & ( BUILTIN_TABLE_SIZE - 1 );
         }
+        builtinTable[ idx ] = builtins[ i ];
     }
 
-    exit( EXIT_SUCCESS );
+    return( EXIT_SUCCESS );
 
-} /* end - MyExit() */
+} /* end - BuiltinInit() */
 
 
 /*****************************************************************************
  *
  * NAME
- *      MyStatus
+ *      BuiltinLookup
  *
  * DESCRIPTION
- *      This function performs the built-in 'status' command by printing out
- *      the exit status of the last terminated child process.
- *  
+ *      This function looks a command name up in the builtin dispatch
+ *      table. External commands, the common case, land on an empty slot on
+ *      their first probe and fail the lookup in O(1) instead of paying a
+ *      string compare against every builtin name.
+ *
+ * NOTES
+ *      Returns NULL when the name is not a builtin.
+ *
  ****************************************************************************/
 
-static int MyStatus(void)
+static builtinEntry *BuiltinLookup
+    (
+    const char         *name            /* The command name to look up      */
+    )
 {
-    /* Inform user of last non-built-in command's exit status. */
-    UTL_FlushedPrintOut( "exit status %d\n", childStatus );
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    size_t      idx;
 
-    return( EXIT_SUCCESS );
+    /* Probe until the name or an empty slot is found. */
+    idx = HashString( name ) & ( BUILTIN_TABLE_SIZE - 1 );
+    while( builtinTable[ idx ].name != NULL )
+    {
+        if( strcmp( builtinTable[ idx ].name, name ) == 0 )
+        {
+            return( &builtinTable[ idx ] );
+        }
+        idx = ( idx + 1 ) & ( BUILTIN_TABLE_SIZE - 1 );
+    }
 
-} /* end - MyStatus() */
+    return( NULL );
+
+} /* end - BuiltinLookup() */
 
 
 /*****************************************************************************
  *
  * NAME
- *      ParseCommand
+ *      ClientSend
  *
  * DESCRIPTION
- *      This function takes user input and parses them into its constituent
- *      parts, filling up the command struct as appropriate. The string is
- *      tokenized on spaces and all tokens are expanded for any instances of 
- *      '$$'. The resulting heap-allocated string is then checked for its
- *      type. The command and most arguments are stored in the command
- *      struct's arg array except for the following:
- *          - Input and output symbols
- *          - The argument immediately following an input/output symbol
- *          - Background indicator '&' if it is the last argument
- *  
+ *      This function is the thin client half of daemon mode. It joins the
+ *      given words into one command line, ships it to the daemon over its
+ *      unix socket, streams the response to stdout, and returns the exit
+ *      status the daemon framed as the marked final line. Client processes
+ *      do nothing else, so automation pays a connect instead of a full
+ *      shell startup per command.
+ *
  ****************************************************************************/
 
-static int ParseCommand
+static int ClientSend
     (
-    char               *buf,            /* The buffer after user input rec'd*/ 
-    cmdStruct          *command         /* The command struct to fill up    */ 
+    const char         *sockPath,       /* The daemon's socket path         */
+    int                 argCount,       /* Number of command words          */
+    char              **argValues       /* The command words to send        */
     )
 {
     /******************************
     *  LOCAL VARIABLES
     ******************************/
-    char       *lp_arg;
-    int         argCount;
-    bool        inputFlag;
-    bool        outputFlag;
-    char       *lp_tempArg;
+    struct sockaddr_un  addr;
+    int                 fd;
+    char                lineBuf[ DAEMON_LINE_MAX ];
+    size_t              lineLen;
+    char               *lp_mark;
+    char               *lp_resp;
+    ssize_t             nRead;
+    size_t              respCap;
+    size_t              respLen;
+    int                 status;
 
     /******************************
     *  INITIALIZE VARIABLES
     ******************************/
-    lp_arg                      = NULL;
-    lp_tempArg                  = NULL;
-    argCount                    = 0;
-    inputFlag                   = FALSE;
-    outputFlag                  = FALSE;
-    command->isBackground       = FALSE;
-    command->isRedirectInput    = FALSE;
-    command->isRedirectOutput   = FALSE;
+    lineLen     = 0;
+    lp_resp     = NULL;
+    respCap     = 0;
+    respLen     = 0;
+    status      = EXIT_FAILURE;
 
-    /* Loop up to MAX_ARGS number of times, filling up command's args array. */
-    for( int i = 0; i < MAX_ARGS; i++ )
+    if( argCount < 1 )
     {
-        /* Tokenize input, ignoring ending newline. */
-        lp_arg = strtok( buf, " \n" );
-        /* Reached end up input tokens. */
-        if( lp_arg == NULL )
-        {
-            break;
-        }
+        fprintf( stderr, "usage: smallsh %s <socket> <command...>\n", CLIENT_FLAG );
+        return( EXIT_FAILURE );
+    }
 
-        /* Set buf to NULL as required for subsequent calls to strtok. */
-        buf = NULL;
+    fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+    if( fd == -1 )
+    {
+        fprintf( stderr, "cannot create client socket\n" );
+        return( EXIT_FAILURE );
+    }
 
-        /* Expand $$ variable. */
-        lp_tempArg = ExpandPID( lp_arg );
+    memset( &addr, 0, sizeof( addr ) );
+    addr.sun_family = AF_UNIX;
+    strncpy( addr.sun_path, sockPath, sizeof( addr.sun_path ) - 1 );
 
-        /*----------------------------------------------- 
-         * Build command struct based on argument value.
-         *---------------------------------------------*/
+    if( connect( fd, (struct sockaddr *)&addr, sizeof( addr ) ) == -1 )
+    {
+        fprintf( stderr, "cannot connect to daemon at %s\n", sockPath );
+        close( fd );
+        return( EXIT_FAILURE );
+    }
 
-        /*-----------------------------------------------
-         * If input indicator was last argument seen,
-         * use next argument as input redirection file.
-         *---------------------------------------------*/
-        if( inputFlag == TRUE )
-        {
-            command->input = lp_tempArg;
-            inputFlag = FALSE;
-        }
-        /*-----------------------------------------------
-         * If output indicator was last argument seen,
-         * use next argument as output redirection file.
-         *---------------------------------------------*/
-        else if( outputFlag == TRUE )
+    /* Join the words back into the line the daemon will parse. */
+    for( int i = 0; i < argCount; i++ )
+    {
+        lineLen += (size_t)snprintf( lineBuf + lineLen, sizeof( lineBuf ) - lineLen,
+                                     "%s%c", argValues[ i ],
+                                     ( i + 1 < argCount ) ? ' ' : '\n' );
+        if( lineLen >= sizeof( lineBuf ) - 1 )
         {
-            command->output = lp_tempArg;
-            outputFlag = FALSE;
+            fprintf( stderr, "command line too long for daemon\n" );
+            close( fd );
+            return( EXIT_FAILURE );
         }
-        /* Current argument is input indicator, set flag. */
-        else if( strncmp( lp_tempArg, INPUT, 2 ) == 0 )
+    }
+
+    if( write( fd, lineBuf, lineLen ) != (ssize_t)lineLen )
+    {
+        fprintf( stderr, "cannot send command to daemon\n" );
+        close( fd );
+        return( EXIT_FAILURE );
+    }
+    shutdown( fd, SHUT_WR );
+
+    /* Pull the whole response; the status rides on the marked tail. */
+    for(;;)
+    {
+        if( respLen + 4096 + 1 > respCap )
         {
-            command->isRedirectInput = TRUE;
-            inputFlag = TRUE;
-            free( lp_tempArg );
+            respCap = ( respCap == 0 ) ? 8192 : respCap * 2;
+            lp_resp = realloc( lp_resp, respCap );
+            if( lp_resp == NULL )
+            {
+                fprintf( stderr, "Failed to allocate response buffer\n" );
+                exit( EXIT_FAILURE );
+            }
         }
-        /* Current argument is output indicator, set flag. */
-        else if( strncmp( lp_tempArg, OUTPUT, 2 ) == 0 )
+
+        nRead = read( fd, lp_resp + respLen, 4096 );
+        if( nRead == -1 && errno == EINTR )
         {
-            command->isRedirectOutput = TRUE;
-            outputFlag = TRUE;
-            free( lp_tempArg );
+            continue;
         }
-        /* All other arguments are stored in argument array. */
-        else
+        if( nRead <= 0 )
         {
-            UTL_DebugPrint( "Argument %d is %s\n", i, lp_tempArg );
-            command->args[ argCount ] = lp_tempArg;
-            argCount++;
+            break;
         }
-
+        respLen += (size_t)nRead;
     }
+    close( fd );
+    lp_resp[ respLen ] = '\0';
 
-    /*----------------------------------------------------------------
-     * Background commands only occur when & is the last character and
-     * a SIGTSTP signal has not set the shell to ignore background
-     * command requests.
-     *--------------------------------------------------------------*/
-    if( argCount > 0 && command->args[ argCount - 1] && ( strncmp( command->args[ argCount - 1 ], BACKGROUND, 2 ) == 0 ) )
+    /* Split off the status line and relay the command output. */
+    lp_mark = memrchr( lp_resp, DAEMON_MARK, respLen );
+    if( lp_mark != NULL )
     {
-        UTL_DebugPrint( "Removing background arg %s\n", command->args[ argCount - 1 ] );
-        if( ignoreBackground == FALSE )
-        {
-            command->isBackground = TRUE;
-        }
-        else
-        {
-            command->isBackground = FALSE;
-        }
-        free( command->args[ argCount - 1 ] );
-        command->args[ argCount - 1 ] = NULL;
+        status = atoi( lp_mark + 1 );
+        fwrite( lp_resp, 1, (size_t)( lp_mark - lp_resp ), stdout );
     }
+    else
+    {
+        fwrite( lp_resp, 1, respLen, stdout );
+    }
+    fflush( stdout );
+    free( lp_resp );
 
-    return( EXIT_SUCCESS );
+    return( status );
 
-} /* end - ParseCommand() */
+} /* end - ClientSend() */
 
 
 /*****************************************************************************
  *
  * NAME
- *      ReapZombies
+ *      CommandSubst
  *
  * DESCRIPTION
- *      This function will clean up any terminated child processes, updating
- *      the global child status appropriately and removing the child's pid
- *      from the child pid array.
- *  
+ *      This function performs $(cmd) command substitution. The body is
+ *      split into the inner command's argv in place, the inner command is
+ *      forked with its stdout on a pipe, and the output is read straight
+ *      into a reusable capture buffer - no intermediate file, no trip
+ *      through the page cache. The capture is then word-split and each
+ *      word lands in the args array as an arena-backed string, exactly
+ *      like any other expanded token.
+ *
+ * NOTES
+ *      Returns the updated argument count. The capture buffer grows to
+ *      the largest substitution seen and is reused after that. Pipes,
+ *      redirects, and nesting inside the body are not interpreted.
+ *
  ****************************************************************************/
 
-static int ReapZombies(void)
+static int CommandSubst
+    (
+    char               *body,           /* The text inside $( )             */
+    cmdStruct          *command,        /* The command receiving the words  */
+    int                 argCount        /* Current argument count           */
+    )
 {
     /******************************
     *  LOCAL VARIABLES
     ******************************/
-    pid_t       pid;
+    static char    *captureBuf = NULL;
+    static size_t   captureCap = 0;
+    size_t          captureLen;
+    char           *innerArgs[ SUBST_MAX_ARGS ];
+    char           *lp_resolved;
+    char           *lp_scan;
+    char           *lp_word;
+    ssize_t         nRead;
+    int             numInner;
+    pid_t           pid;
+    int             pipeFds[ 2 ];
+    int             substStatus;
+    size_t          wordLen;
 
     /******************************
     *  INITIALIZE VARIABLES
     ******************************/
-    pid         = 0;
+    captureLen  = 0;
+    numInner    = 0;
 
-    
-    /* Loop until all zombie children are reaped. */
-    while( ( pid = waitpid( -1, &childStatus, WNOHANG ) ) > 0 )
+    /* Split the body into the inner command's argv, in place. */
+    lp_scan = body;
+    while( *lp_scan != '\0' && numInner < SUBST_MAX_ARGS - 1 )
     {
-        /* Inform user when background child has terminated. */
-        UTL_FlushedPrintOut( "background pid %d is done: ", pid );
-        
-        /* If child was terminated by signal, inform user. */
-        if( WIFSIGNALED( childStatus ) )
+        while( *lp_scan == ' ' )
         {
-            UTL_FlushedPrintOut( "terminated by signal %d\n", WTERMSIG( childStatus ) );
+            lp_scan += 1;
         }
-        /* Otherwise, inform user of exit status. */
-        else
+        if( *lp_scan == '\0' )
         {
-            UTL_FlushedPrintOut( "exit value %d\n", childStatus );
+            break;
         }
-        
-        /* Find and remove child from pids array. */
-        RemoveChildPid( pid );
-        continue;
+        innerArgs[ numInner ] = lp_scan;
+        while( *lp_scan != ' ' && *lp_scan != '\0' )
+        {
+            lp_scan += 1;
+        }
+        if( *lp_scan == ' ' )
+        {
+            *lp_scan  = '\0';
+            lp_scan  += 1;
+        }
+        /* Inner tokens get the same variable expansion as outer ones. */
+        if( strchr( innerArgs[ numInner ], '$' ) != NULL )
+        {
+            innerArgs[ numInner ] = ExpandVars( innerArgs[ numInner ] );
+        }
+        numInner += 1;
     }
-    
-    /* Reset flag */
-    childTerminated = FALSE;
+    innerArgs[ numInner ] = NULL;
 
-    return( EXIT_SUCCESS );
+    if( numInner == 0 )
+    {
+        return( argCount );
+    }
 
-} /* end - ReapZombies() */
+    if( pipe( pipeFds ) == -1 )
+    {
+        fprintf( stderr, "cannot create substitution pipe\n" );
+        return( argCount );
+    }
 
+    lp_resolved = ResolvePath( innerArgs[ 0 ] );
 
-/*****************************************************************************
- *
- * NAME
- *      RemoveChildPid
- *
- * DESCRIPTION
- *      This function removes a given pid from the child pid array.      
- *
- * NOTES
- *      Assumes that the child pid array is statically-allocated and of size
- *      MAX_CHILDREN.
- *  
- ****************************************************************************/
+    pid = fork();
+    if( pid == -1 )
+    {
+        close( pipeFds[ 0 ] );
+        close( pipeFds[ 1 ] );
+        return( argCount );
+    }
 
-static int RemoveChildPid
-    (
-    pid_t               pid             /* The pid to remove from bg array  */ 
-    )
-{
-    /* Loop through array of background pids until pid found. */
-    for( size_t i = 0; i < MAX_CHILDREN; i++ )
+    if( pid == 0 )
+    {
+        /* Child: stdout into the capture pipe, then exec. */
+        close( pipeFds[ 0 ] );
+        dup2( pipeFds[ 1 ], STDOUT_FILENO );
+        close( pipeFds[ 1 ] );
+
+        /* Substitutions run in the foreground; let SIGINT through. */
+        struct sigaction SIGINT_action = {0};
+        SIGINT_action.sa_handler = SIG_DFL;
+        sigaction( SIGINT, &SIGINT_action, NULL );
+
+        if( lp_resolved != NULL )
+        {
+            execv( lp_resolved, innerArgs );
+        }
+        execvp( innerArgs[ 0 ], innerArgs );
+        fprintf( stderr, "%s: no such file or directory\n", innerArgs[ 0 ] );
+        exit( EXIT_FAILURE );
+    }
+
+    /* Parent: pull the whole capture off the pipe as it arrives. */
+    close( pipeFds[ 1 ] );
+    for(;;)
     {
-        if( childPids[ i ] == pid )
+        if( captureLen + 4096 + 1 > captureCap )
+        {
+            captureCap = ( captureCap == 0 ) ? 8192 : captureCap * 2;
+            captureBuf = realloc( captureBuf, captureCap );
+            if( captureBuf == NULL )
+            {
+                fprintf( stderr, "Failed to allocate capture buffer\n" );
+                exit( EXIT_FAILURE );
+            }
+        }
+
+        nRead = read( pipeFds[ 0 ], captureBuf + captureLen, 4096 );
+        if( nRead == -1 && errno == EINTR )
+        {
+            continue;
+        }
+        if( nRead <= 0 )
         {
-            UTL_DebugPrint( "Removing pid %d\n", pid );
-            /* Clear out array index matching given pid. */
-            childPids[ i ] = 0;
             break;
         }
+        captureLen += (size_t)nRead;
     }
+    close( pipeFds[ 0 ] );
 
-    return( EXIT_SUCCESS );
+    waitpid( pid, &substStatus, 0 );
 
-} /* end - RemoveChildPid() */
+    /* Appease compiler warning. */
+    if( substStatus )
+    {
+        ;
+    }
+
+    captureBuf[ captureLen ] = '\0';
+
+    /*----------------------------------------------------------------
+     * Word-split the capture on whitespace; each word becomes an
+     * arena string in the args array, so newline-separated output
+     * fans out into arguments just like it does in bigger shells.
+     *--------------------------------------------------------------*/
+    lp_scan = captureBuf;
+    while( *lp_scan != '\0' && argCount < MAX_ARGS - 1 )
+    {
+        while( *lp_scan == ' ' || *lp_scan == '\t' || *lp_scan == '\n' )
+        {
+            lp_scan += 1;
+        }
+        if( *lp_scan == '\0' )
+        {
+            break;
+        }
+        wordLen = strcspn( lp_scan, " \t\n" );
+
+        lp_word = UTL_ArenaAlloc( wordLen + 1 );
+        memcpy( lp_word, lp_scan, wordLen );
+        lp_word[ wordLen ] = '\0';
+
+        command->args[ argCount ] = lp_word;
+        argCount += 1;
+
+        lp_scan += wordLen;
+    }
+
+    return( argCount );
+
+} /* end - CommandSubst() */
 
 
 /*****************************************************************************
  *
  * NAME
- *      RunCommand
+ *      CompleteToken
  *
  * DESCRIPTION
- *      This function runs the most recently entered and parsed command.     
- *  
+ *      This function completes the token under the cursor in response to a
+ *      Tab press. A token in command position is matched against the sorted
+ *      PATH index with a binary search; any other token is treated as a
+ *      file name and matched against its directory's listing, served
+ *      through the glob scan cache so no extra directory walk happens. The
+ *      shared prefix of all candidates is spliced into the line and echoed;
+ *      when nothing further is shared the candidates are listed and the
+ *      prompt is reissued with the line typed so far.
+ *
+ * NOTES
+ *      Hidden files only complete when the typed prefix names the leading
+ *      dot, matching the glob engine's rule.
+ *
  ****************************************************************************/
 
-static int RunCommand
+static int CompleteToken
     (
-    cmdStruct          *command         /* The command to run               */ 
+    char              **buf,            /* In/out: growable line buffer     */
+    size_t             *cap,            /* In/out: capacity of the buffer   */
+    size_t             *len             /* In/out: characters in the line   */
     )
 {
-    /* Don't dereference NULL pointers */
-    if( command == NULL )
-    {
-        fprintf( stderr, "Invalid Command Struct provided.\n" );
-        return( EXIT_FAILURE );
-    }
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    const char     *cands[ COMPLETE_MAX ];
+    size_t          common;
+    char            dir[ PATH_MAX_LEN ];
+    size_t          dirLen;
+    size_t          extra;
+    size_t          idx;
+    const char     *lp_base;
+    globDirEntry   *lp_entry;
+    char           *lp_line;
+    const char     *lp_name;
+    char           *lp_slash;
+    size_t          numCands;
+    size_t          probeLen;
+    char            token[ PATH_MAX_LEN ];
+    size_t          tokenLen;
+    size_t          tokenStart;
+
+    /******************************
+    *  INITIALIZE VARIABLES
+    ******************************/
+    lp_line     = *buf;
+    numCands    = 0;
+
+    /* Find the token under completion: everything back to the last space. */
+    tokenStart = *len;
+    while( tokenStart > 0 && lp_line[ tokenStart - 1 ] != ' ' )
+    {
+        tokenStart -= 1;
+    }
+    tokenLen = *len - tokenStart;
+    if( tokenLen == 0 || tokenLen + 1 >= sizeof( token ) )
+    {
+        return( EXIT_FAILURE );
+    }
+    memcpy( token, lp_line + tokenStart, tokenLen );
+    token[ tokenLen ] = '\0';
+
+    lp_slash = strrchr( token, '/' );
+
+    if( tokenStart == 0 && lp_slash == NULL )
+    {
+        /*---------------------------------------------------------------
+         * Command position: binary-search the sorted PATH index for the
+         * run of names sharing the typed prefix.
+         *-------------------------------------------------------------*/
+        if( PathIndexEnsure() != EXIT_SUCCESS )
+        {
+            return( EXIT_FAILURE );
+        }
+
+        lp_base  = token;
+        probeLen = tokenLen;
+        idx      = PathIndexLower( token );
+        while( idx < pathIndexCount && numCands < COMPLETE_MAX
+            && strncmp( pathIndex[ idx ], token, probeLen ) == 0 )
+        {
+            cands[ numCands ] = pathIndex[ idx ];
+            numCands += 1;
+            idx      += 1;
+        }
+    }
+    else
+    {
+        /*---------------------------------------------------------------
+         * Argument (or explicit path) position: complete against the
+         * directory listing, served through the glob cache.
+         *-------------------------------------------------------------*/
+        if( lp_slash != NULL )
+        {
+            dirLen = (size_t)( lp_slash - token );
+            if( dirLen == 0 )
+            {
+                /* Pattern rooted at /: the directory part is just "/". */
+                strcpy( dir, "/" );
+            }
+            else
+            {
+                memcpy( dir, token, dirLen );
+                dir[ dirLen ] = '\0';
+            }
+            lp_base = lp_slash + 1;
+        }
+        else
+        {
+            strcpy( dir, "." );
+            lp_base = token;
+        }
+        probeLen = strlen( lp_base );
+
+        lp_entry = GlobScanDir( dir );
+        if( lp_entry == NULL )
+        {
+            return( EXIT_FAILURE );
+        }
+
+        for( size_t i = 0; i < lp_entry->numNames && numCands < COMPLETE_MAX; i++ )
+        {
+            lp_name = lp_entry->names[ i ];
+            /* Hidden entries only complete when the prefix asks for them. */
+            if( lp_name[ 0 ] == '.' && lp_base[ 0 ] != '.' )
+            {
+                continue;
+            }
+            if( strncmp( lp_name, lp_base, probeLen ) == 0 )
+            {
+                cands[ numCands ] = lp_name;
+                numCands += 1;
+            }
+        }
+    }
+
+    if( numCands == 0 )
+    {
+        return( EXIT_FAILURE );
+    }
+
+    /* Longest prefix every candidate shares, measured from the start. */
+    common = strlen( cands[ 0 ] );
+    for( size_t i = 1; i < numCands; i++ )
+    {
+        size_t j = 0;
+        while( j < common && cands[ i ][ j ] == cands[ 0 ][ j ] )
+        {
+            j += 1;
+        }
+        common = j;
+    }
+
+    /*----------------------------------------------------------------
+     * Splice the shared remainder into the line. A unique match also
+     * gets the trailing space the user would have typed next.
+     *--------------------------------------------------------------*/
+    extra = common - probeLen;
+    if( numCands == 1 )
+    {
+        extra += 1;
+    }
+    if( extra > 0 )
+    {
+        while( *len + extra + 3 > *cap )
+        {
+            *cap *= 2;
+            *buf  = realloc( *buf, *cap );
+            if( *buf == NULL )
+            {
+                fprintf( stderr, "Failed to grow input buffer\n" );
+                exit( EXIT_FAILURE );
+            }
+        }
+        lp_line = *buf;
+        memcpy( lp_line + *len, cands[ 0 ] + probeLen, common - probeLen );
+        if( numCands == 1 )
+        {
+            lp_line[ *len + ( common - probeLen ) ] = ' ';
+        }
+        if( write( STDOUT_FILENO, lp_line + *len, extra ) == -1 )
+        {
+            ;
+        }
+        *len += extra;
+
+        return( EXIT_SUCCESS );
+    }
+
+    /*----------------------------------------------------------------
+     * Nothing further is shared: show the candidates and reissue the
+     * prompt with the line typed so far.
+     *--------------------------------------------------------------*/
+    UTL_FlushedPrintOut( "\n" );
+    for( size_t i = 0; i < numCands; i++ )
+    {
+        UTL_FlushedPrintOut( "%s  ", cands[ i ] );
+    }
+    UTL_FlushedPrintOut( "\n: " );
+    if( write( STDOUT_FILENO, *buf, *len ) == -1 )
+    {
+        ;
+    }
+
+    return( EXIT_SUCCESS );
+
+} /* end - CompleteToken() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      DaemonServe
+ *
+ * DESCRIPTION
+ *      This function runs the shell as a resident command service. It
+ *      binds a unix domain socket and serves one connection at a time:
+ *      each client sends a single command line, which runs through the
+ *      normal RunCommandList machinery with stdout pointed at the
+ *      connection, and the final exit status goes back as a marked last
+ *      line. One warm process keeps the PATH, glob, and redirection
+ *      caches hot across hundreds of short-lived clients instead of
+ *      rebuilding them per shell launch.
+ *
+ * NOTES
+ *      Does not return; a client sending 'exit' shuts the daemon down
+ *      through the normal MyExit path.
+ *
+ ****************************************************************************/
+
+static int DaemonServe
+    (
+    const char         *sockPath        /* Where to bind the socket         */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    struct sockaddr_un  addr;
+    int                 clientFd;
+    cmdStruct           daemonCmd;
+    char                lineBuf[ DAEMON_LINE_MAX ];
+    size_t              lineLen;
+    int                 listenFd;
+    ssize_t             nRead;
+    int                 savedOut;
+    char                statusLine[ 32 ];
+    int                 statusLen;
+
+    /******************************
+    *  INITIALIZE VARIABLES
+    ******************************/
+    memset( &daemonCmd, 0, sizeof( daemonCmd ) );
+    daemonCmd.hereFd = -1;
+
+    listenFd = socket( AF_UNIX, SOCK_STREAM, 0 );
+    if( listenFd == -1 )
+    {
+        fprintf( stderr, "cannot create daemon socket\n" );
+        exit( EXIT_FAILURE );
+    }
+
+    memset( &addr, 0, sizeof( addr ) );
+    addr.sun_family = AF_UNIX;
+    strncpy( addr.sun_path, sockPath, sizeof( addr.sun_path ) - 1 );
+
+    /* Reclaim the path from any previous daemon instance. */
+    unlink( sockPath );
+
+    if( bind( listenFd, (struct sockaddr *)&addr, sizeof( addr ) ) == -1
+     || listen( listenFd, DAEMON_BACKLOG ) == -1 )
+    {
+        fprintf( stderr, "cannot bind daemon socket at %s\n", sockPath );
+        exit( EXIT_FAILURE );
+    }
+
+    UTL_FlushedPrintOut( "smallsh daemon listening on %s\n", sockPath );
+
+    for(;;)
+    {
+        clientFd = accept( listenFd, NULL, NULL );
+        if( clientFd == -1 )
+        {
+            /* Interrupted by a signal (e.g. SIGCHLD); just re-accept. */
+            if( errno == EINTR )
+            {
+                DrainChildEvents();
+                UTL_FlushOutput();
+                continue;
+            }
+            break;
+        }
+
+        /* Read one command line off the connection. */
+        lineLen = 0;
+        while( lineLen < sizeof( lineBuf ) - 1 )
+        {
+            nRead = read( clientFd, lineBuf + lineLen,
+                          sizeof( lineBuf ) - 1 - lineLen );
+            if( nRead == -1 && errno == EINTR )
+            {
+                continue;
+            }
+            if( nRead <= 0 )
+            {
+                break;
+            }
+            lineLen += (size_t)nRead;
+            if( memchr( lineBuf, '\n', lineLen ) != NULL )
+            {
+                break;
+            }
+        }
+        lineBuf[ lineLen ] = '\0';
+
+        if( lineLen == 0 )
+        {
+            close( clientFd );
+            continue;
+        }
+
+        /*---------------------------------------------------------------
+         * Point stdout at the client for the duration of the command,
+         * so children and builtins alike stream straight back over the
+         * socket with no buffering layer in between.
+         *-------------------------------------------------------------*/
+        UTL_FlushOutput();
+        fflush( stdout );
+        savedOut = dup( STDOUT_FILENO );
+        dup2( clientFd, STDOUT_FILENO );
+
+        ResetCommand( &daemonCmd );
+        RunCommandList( lineBuf, &daemonCmd );
+        FreeArgs( &daemonCmd );
+        DrainChildEvents();
+        UTL_FlushOutput();
+        fflush( stdout );
+
+        dup2( savedOut, STDOUT_FILENO );
+        close( savedOut );
+
+        /* Frame the exit status as the marked last line and hang up. */
+        statusLen = snprintf( statusLine, sizeof( statusLine ), "%c%d\n",
+                              DAEMON_MARK, childStatus );
+        if( write( clientFd, statusLine, (size_t)statusLen ) == -1 )
+        {
+            ;
+        }
+        close( clientFd );
+    }
+
+    exit( EXIT_SUCCESS );
+
+} /* end - DaemonServe() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      DrainChildEvents
+ *
+ * DESCRIPTION
+ *      This function empties the SIGCHLD self-pipe and, if any exit events
+ *      were pending, reaps the corresponding zombies. Costs a single
+ *      non-blocking read when nothing has happened.
+ *
+ ****************************************************************************/
+
+static int DrainChildEvents(void)
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    char        drainBuf[ 64 ];
+    ssize_t     nRead;
+    bool        pending;
+
+    /******************************
+    *  INITIALIZE VARIABLES
+    ******************************/
+    pending     = FALSE;
+
+    /* Swallow every queued wakeup byte. */
+    while( ( nRead = read( sigChldPipe[ 0 ], drainBuf, sizeof( drainBuf ) ) ) > 0 )
+    {
+        pending = TRUE;
+    }
+
+    if( pending == TRUE )
+    {
+        ReapZombies();
+    }
+
+    return( EXIT_SUCCESS );
+
+} /* end - DrainChildEvents() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      EnvCacheReset
+ *
+ * DESCRIPTION
+ *      This function empties the environment lookup cache. It is called by
+ *      the export builtin, the only path through which the environment can
+ *      change under a running shell, so cached getenv results never go
+ *      stale silently.
+ *
+ ****************************************************************************/
+
+static int EnvCacheReset(void)
+{
+    for( size_t i = 0; i < ENV_CACHE_SIZE; i++ )
+    {
+        if( envCache[ i ].name != NULL )
+        {
+            free( envCache[ i ].name );
+            free( envCache[ i ].value );
+            envCache[ i ].name  = NULL;
+            envCache[ i ].value = NULL;
+        }
+    }
+    envCacheCount = 0;
+
+    return( EXIT_SUCCESS );
+
+} /* end - EnvCacheReset() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      EnvLookup
+ *
+ * DESCRIPTION
+ *      This function looks an environment variable up through the lookup
+ *      cache, asking getenv only on a miss and remembering the answer -
+ *      including the negative one, so repeatedly referencing an unset
+ *      variable does not rescan the environment every time.
+ *
+ * NOTES
+ *      Returns NULL when the variable is unset. The returned string is
+ *      owned by the cache and must NOT be freed by the caller.
+ *
+ ****************************************************************************/
+
+static char *EnvLookup
+    (
+    const char         *name            /* The variable name to look up     */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    char       *lp_value;
+    size_t      slot;
+
+    /* Probe until the name or an empty slot is found. */
+    slot = HashString( name ) & ( ENV_CACHE_SIZE - 1 );
+    while( envCache[ slot ].name != NULL )
+    {
+        if( strcmp( envCache[ slot ].name, name ) == 0 )
+        {
+            return( envCache[ slot ].value );
+        }
+        slot = ( slot + 1 ) & ( ENV_CACHE_SIZE - 1 );
+    }
+
+    lp_value = getenv( name );
+
+    /* Remember the answer while the table is sparse enough to probe well. */
+    if( envCacheCount < ENV_CACHE_SIZE / 2 )
+    {
+        envCache[ slot ].name  = strdup( name );
+        envCache[ slot ].value = ( lp_value != NULL ) ? strdup( lp_value )
+                                                      : NULL;
+        envCacheCount += 1;
+        return( envCache[ slot ].value );
+    }
+
+    return( lp_value );
+
+} /* end - EnvLookup() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      ExpandVarRef
+ *
+ * DESCRIPTION
+ *      Given a cursor positioned at a '$', this function decides whether it
+ *      introduces a variable reference and resolves it. '$$' resolves to
+ *      the cached shell pid string; '${NAME}' and '$NAME' resolve through
+ *      the environment lookup cache, with an unset variable resolving to
+ *      the empty string. refLen receives the number of input bytes the
+ *      reference spans so the caller can step over it.
+ *
+ * NOTES
+ *      Returns NULL when the '$' does not introduce a reference (a lone
+ *      '$', '$(', '${' with no closing brace, ...) and the byte should be
+ *      copied through literally.
+ *
+ ****************************************************************************/
+
+static char *ExpandVarRef
+    (
+    const char         *scan,           /* Cursor positioned at a '$'       */
+    size_t             *refLen          /* Out: bytes the reference spans   */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    size_t      len;
+    const char *lp_end;
+    char       *lp_value;
+    char        name[ ENV_NAME_MAX ];
+
+    /* $$ expands to the shell pid. */
+    if( scan[ 1 ] == '$' )
+    {
+        *refLen = 2;
+        return( shellPidStr );
+    }
+
+    /* ${NAME}: everything up to the closing brace is the name. */
+    if( scan[ 1 ] == '{' )
+    {
+        lp_end = strchr( scan + 2, '}' );
+        if( lp_end == NULL || lp_end == scan + 2
+         || (size_t)( lp_end - ( scan + 2 ) ) >= sizeof( name ) )
+        {
+            return( NULL );
+        }
+        len = lp_end - ( scan + 2 );
+        memcpy( name, scan + 2, len );
+        name[ len ] = '\0';
+        *refLen = len + 3;
+    }
+    /* $NAME: a letter or underscore, then letters, digits, underscores. */
+    else if( isalpha( (unsigned char)scan[ 1 ] ) || scan[ 1 ] == '_' )
+    {
+        len = 1;
+        while( len < sizeof( name ) - 1
+            && ( isalnum( (unsigned char)scan[ 1 + len ] )
+              || scan[ 1 + len ] == '_' ) )
+        {
+            len += 1;
+        }
+        memcpy( name, scan + 1, len );
+        name[ len ] = '\0';
+        *refLen = len + 1;
+    }
+    /* Anything else keeps its '$' literally, '$(' substitution included. */
+    else
+    {
+        return( NULL );
+    }
+
+    lp_value = EnvLookup( name );
+
+    return( ( lp_value != NULL ) ? lp_value : "" );
+
+} /* end - ExpandVarRef() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      ExpandVars
+ *
+ * DESCRIPTION
+ *      Given a pointer to a string, this function will allocate space out of
+ *      the per-command arena for a new string in which every variable
+ *      reference - '$$', '${NAME}', and '$NAME' - has been expanded. A
+ *      pre-scan measures each reference's replacement so the allocation is
+ *      sized exactly, and the result is built in a single forward pass
+ *      through a write cursor.
+ *
+ * NOTES
+ *      The memory returned by this function lives until the next call to
+ *      FreeArgs and must NOT be freed by the caller.
+ *
+ ****************************************************************************/
+
+static char *ExpandVars
+    (
+    char               *arg             /* The string to expand             */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    char       *lp_newArg;
+    char       *lp_out;
+    const char *lp_scan;
+    char       *lp_value;
+    size_t      outLen;
+    size_t      refLen;
+    size_t      span;
+    size_t      valueLen;
+
+    /******************************
+    *  INITIALIZE VARIABLES
+    ******************************/
+    outLen      = 0;
+
+    /*----------------------------------------------------------------
+     * Pre-scan: measure every reference's replacement so the
+     * allocation below is sized exactly. Literal runs between '$'
+     * bytes are skipped through the vectorized scanner; lookups hit
+     * the environment cache, so resolving each reference twice costs
+     * one probe.
+     *--------------------------------------------------------------*/
+    for( lp_scan = arg; *lp_scan != '\0'; )
+    {
+        span     = UTL_ScanSpan( lp_scan, '$', '$' );
+        outLen  += span;
+        lp_scan += span;
+        if( *lp_scan == '\0' )
+        {
+            break;
+        }
+        if( ( lp_value = ExpandVarRef( lp_scan, &refLen ) ) != NULL )
+        {
+            outLen  += strlen( lp_value );
+            lp_scan += refLen;
+        }
+        else
+        {
+            outLen  += 1;
+            lp_scan += 1;
+        }
+    }
+
+    lp_newArg = UTL_ArenaAlloc( outLen + 1 );
+
+    /*----------------------------------------------------------------
+     * Single forward pass: copy each literal run in one memcpy,
+     * splicing in each reference's replacement as it is reached.
+     *--------------------------------------------------------------*/
+    lp_out = lp_newArg;
+    while( *arg != '\0' )
+    {
+        span = UTL_ScanSpan( arg, '$', '$' );
+        memcpy( lp_out, arg, span );
+        lp_out += span;
+        arg    += span;
+        if( *arg == '\0' )
+        {
+            break;
+        }
+        if( ( lp_value = ExpandVarRef( arg, &refLen ) ) != NULL )
+        {
+            valueLen = strlen( lp_value );
+            memcpy( lp_out, lp_value, valueLen );
+            lp_out += valueLen;
+            arg    += refLen;
+        }
+        else
+        {
+            *lp_out  = '$';
+            lp_out  += 1;
+            arg     += 1;
+        }
+    }
+    *lp_out = '\0';
+
+    UTL_DebugPrint( " new arg: %s\n", lp_newArg );
+
+    return( lp_newArg );
+
+} /* end - ExpandVars() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      ExternalCommand
+ *
+ * DESCRIPTION
+ *      This function launches a child process for the given external
+ *      (non-built-in) command. The default launch engine is posix_spawn,
+ *      which avoids fork's page-table duplication cost; the classic
+ *      fork+exec path is kept as a fallback for when spawn fails. The
+ *      parent process will either wait for the child to terminate
+ *      (foreground) or store the child's pid and continue on to processing
+ *      the next command (background).
+ *
+ ****************************************************************************/
+
+static int ExternalCommand
+    (
+    cmdStruct          *command         /* The command to run as a child    */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    pid_t           pid;
+    char           *lp_resolved;
+    struct timespec stageStart;
+    struct rusage   usage;
+
+    /******************************
+    *  INITIALIZE VARIABLES
+    ******************************/
+    pid         = -1;
+
+    /* Multi-stage pipelines get their own concurrent launch engine. */
+    if( command->numStages > 1 )
+    {
+        return( PipelineCommand( command ) );
+    }
+
+    /*----------------------------------------------------------------
+     * Resolve the command through the PATH cache before launching so
+     * the resolution (and any cache fill) happens once in the parent
+     * and the child can exec directly.
+     *--------------------------------------------------------------*/
+    lp_resolved = ResolvePath( command->args[ 0 ] );
+
+    /*----------------------------------------------------------------
+     * Launch the child. posix_spawn is the default engine; fall back
+     * to fork+exec when spawn cannot launch the command.
+     *--------------------------------------------------------------*/
+    StatsBegin( &stageStart );
+    if( SpawnCommand( command, lp_resolved, &pid ) != EXIT_SUCCESS )
+    {
+        /* Fallback failure means a redirect target could not be opened. */
+        if( ForkCommand( command, lp_resolved, &pid ) != EXIT_SUCCESS )
+        {
+            childStatus = 1;
+            return( EXIT_FAILURE );
+        }
+    }
+    StatsRecord( STAT_STAGE_LAUNCH, &stageStart );
+
+    /* Could not create child process */
+    if( pid == -1 )
+    {
+        fprintf( stderr, "Failed to fork child process\n" );
+        return( EXIT_SUCCESS );
+    }
+
+    UTL_DebugPrint( "Parent Process: %d\n", pid );
+
+    /* Add child to list of child pids. */
+    AddChildPid( pid, command->args[ 0 ] );
+
+    /* Concurrent list member: the scheduler joins it later. */
+    if( command->isConcurrent == TRUE )
+    {
+        schedLastPid = pid;
+        return( EXIT_SUCCESS );
+    }
+
+    /* Wait and block until foreground process completes. */
+    if( command->isBackground == FALSE )
+    {
+        /*-----------------------------------------------------------------
+         * If SIGTSTP signal arrives while waiting for foreground process,
+         * need to know to print out message that we're changed FG/BG modes
+         * before next user input. This flag is used by the SIGTSTP handler
+         * to make that determination.
+         *---------------------------------------------------------------*/
+        foregroundChild = TRUE;
+        /* Safe point: about to block, so emit any queued notices now. */
+        UTL_FlushOutput();
+        StatsBegin( &stageStart );
+        wait4( pid, &childStatus, 0, &usage );
+        StatsRecord( STAT_STAGE_REAP, &stageStart );
+        UTL_Trace( UTL_TRACE_REAP, pid, childStatus );
+        /* Record the finished job and remove it from the job table. */
+        JobRecordAdd( pid, childStatus, &usage );
+        RemoveChildPid( pid );
+        foregroundChild = FALSE;
+
+        /* If child was terminated by a signal, display the signal to the user. */
+        if( WIFSIGNALED( childStatus ) )
+        {
+            UTL_FlushedPrintOut( "terminated by signal %d\n", WTERMSIG( childStatus ) );
+        }
+        /* If a child terminated normally with a non-0 status, get that status. */
+        else if( childStatus != 0 )
+        {
+            childStatus = WIFEXITED( childStatus );
+        }
+    }
+    /* Inform user of background process's pid. */
+    else
+    {
+        UTL_FlushedPrintOut( "background pid is %d\n", pid );
+    }
+
+    return( EXIT_SUCCESS );
+
+} /* end - ExternalCommand() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      ForkCommand
+ *
+ * DESCRIPTION
+ *      This function is the fallback launch engine. It forks a child
+ *      process, sets it up according to the specification of the command
+ *      struct, and then calls exec() on the command. If exec fails, the
+ *      child process will exit with an exit status.
+ *
+ ****************************************************************************/
+
+static int ForkCommand
+    (
+    cmdStruct          *command,        /* The command to run as a child    */
+    char               *resolved,       /* Cached absolute path, or NULL    */
+    pid_t              *pid             /* Out: pid of the forked child     */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    int         inputFd;
+    int         outputFd;
+
+    /******************************
+    *  INITIALIZE VARIABLES
+    ******************************/
+    inputFd     = -1;
+    outputFd    = -1;
+
+    /*---------------------------------------------------------------
+     * Open redirect targets in the parent through the fd cache
+     * before forking, mirroring SpawnCommand. The cache owns the
+     * fds; the child just dup2s them over its stdio.
+     *-------------------------------------------------------------*/
+    if( command->isRedirectOutput == TRUE )
+    {
+        UTL_DebugPrint( "Redirecting stdout to %s\n", command->output );
+        outputFd = UTL_RedirOpen( command->output,
+            O_WRONLY | O_CREAT | ( ( command->isAppendOutput == TRUE ) ? O_APPEND : O_TRUNC ) );
+        if( outputFd == -1 )
+        {
+            fprintf( stderr, "cannot open %s for output\n", command->output );
+            return( EXIT_FAILURE );
+        }
+    }
+    /*---------------------------------------------------------------
+     * Background processes that aren't otherwise redirecting their
+     * inputs or outputs will have their inputs/outputs redirected
+     * from/to dev/null, respectively.
+     *-------------------------------------------------------------*/
+    else if( command->isBackground == TRUE )
+    {
+        outputFd = UTL_RedirOpen( DEV_NULL, O_WRONLY );
+    }
+    /* A here-string payload beats a file redirect for stdin. */
+    if( command->hereFd != -1 )
+    {
+        lseek( command->hereFd, 0, SEEK_SET );
+        inputFd = command->hereFd;
+    }
+    else if( command->isRedirectInput == TRUE )
+    {
+        UTL_DebugPrint( "Redirecting stdin from %s\n", command->input );
+        inputFd = UTL_RedirOpen( command->input, O_RDONLY );
+        if( inputFd == -1 )
+        {
+            fprintf( stderr, "cannot open %s for input\n", command->input );
+            return( EXIT_FAILURE );
+        }
+    }
+    else if( command->isBackground == TRUE )
+    {
+        inputFd = UTL_RedirOpen( DEV_NULL, O_RDONLY );
+    }
+
+    *pid = fork();
+
+    /* Parent process (or fork failure) returns to ExternalCommand. */
+    if( *pid != 0 )
+    {
+        if( *pid > 0 )
+        {
+            UTL_Trace( UTL_TRACE_FORK, *pid, 0 );
+        }
+        return( EXIT_SUCCESS );
+    }
+
+    /* Child process drops in here */
+    UTL_DebugPrint( "Child Process: %d\n", *pid );
+
+    /* Reset SIGCHLD to default handler */
+    struct sigaction SIGCHLD_action = {0};
+    SIGCHLD_action.sa_handler = SIG_DFL;
+    sigaction( SIGCHLD, &SIGCHLD_action, NULL );
+
+    /* Ignore SIGTSTP signals */
+    struct sigaction SIGTSTP_action = {0};
+    SIGTSTP_action.sa_handler = SIG_IGN;
+    sigaction( SIGTSTP, &SIGTSTP_action, NULL );
+
+    /* Plumb the cached fds onto this child's stdio. */
+    if( outputFd != -1 )
+    {
+        dup2( outputFd, STDOUT_FILENO );
+    }
+    if( inputFd != -1 )
+    {
+        dup2( inputFd, STDIN_FILENO );
+    }
+
+    /* Stop ignoring SIGINT for foreground processes */
+    if( command->isBackground == FALSE )
+    {
+        struct sigaction SIGINT_action = {0};
+        SIGINT_action.sa_handler = SIG_DFL;
+        sigaction( SIGINT, &SIGINT_action, NULL );
+    }
+
+    /*---------------------------------------------------------------
+     * Exec the command. A cached resolution lets us execv() the
+     * absolute path directly, skipping execvp's walk of every PATH
+     * entry. Fall back to execvp on a cache miss or a stale entry.
+     * Exec only returns if it fails; report failure and exit. The
+     * cached fds close themselves on exec.
+     *-------------------------------------------------------------*/
+    if( resolved != NULL )
+    {
+        execv( resolved, command->args );
+    }
+    if( execvp( command->args[0], command->args ) == -1 )
+    {
+        UTL_FlushedPrintOut( "%s: no such file or directory\n", command->args[0] );
+    }
+
+    exit( EXIT_FAILURE );
+
+} /* end - ForkCommand() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      FreeArgs
+ *
+ * DESCRIPTION
+ *      This function releases all of the argument memory for a command in
+ *      one O(1) arena reset. Token strings are either borrowed from the
+ *      input buffer (no cleanup needed) or carved out of the arena by
+ *      ExpandVars, so there is no need to walk the args array freeing
+ *      entries one at a time.
+ *
+ ****************************************************************************/
+
+static int FreeArgs
+    (
+    cmdStruct          *command         /* The command whose args to free   */
+    )
+{
+    /* Appease compiler warning. */
+    if( command )
+    {
+        ;
+    }
+
+    /* Release every token string at once. */
+    UTL_ArenaReset();
+
+    return( EXIT_SUCCESS );
+
+} /* end - FreeArgs() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      GetInput
+ *
+ * DESCRIPTION
+ *      This function prompts the user for input. While waiting it polls
+ *      stdin alongside the SIGCHLD self-pipe, so any child that dies while
+ *      the shell is sitting at the prompt is reaped and reported
+ *      immediately instead of after the next command completes. The
+ *      terminal is taken out of canonical mode for the read so Tab can be
+ *      intercepted for completion; the line is assembled byte by byte into
+ *      the caller-owned growable buffer, which grows to fit the longest
+ *      line seen and is reused from then on. When terminal control is not
+ *      available the read falls back to plain getline.
+ *
+ * NOTES
+ *      Any trailing newline is not removed from the string captured in this
+ *      function.
+ *
+ ****************************************************************************/
+
+static int GetInput
+    (
+    char              **buf,            /* In/out: growable line buffer     */
+    size_t             *n               /* In/out: capacity of the buffer   */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    char            ch;
+    size_t          len;
+    ssize_t         nRead;
+    struct pollfd   pollFds[ 2 ];
+    bool            rawMode;
+    struct termios  rawTio;
+    struct termios  savedTio;
+
+    /******************************
+    *  INITIALIZE VARIABLES
+    ******************************/
+    len     = 0;
+    rawMode = FALSE;
+
+    /*-----------------------------------------------------------------------
+     * One writev covers the whole prompt cycle: queued completion notices,
+     * any mode change SIGTSTP recorded while a foreground process was
+     * running, and the prompt itself.
+     *---------------------------------------------------------------------*/
+    PromptFlush();
+
+    /*-----------------------------------------------------------------------
+     * Take the terminal out of canonical mode so Tab reaches the shell
+     * before the line is submitted. Echo moves here too, since completion
+     * splices characters the user never typed. ISIG is left alone, so
+     * control characters still raise their signals as before.
+     *---------------------------------------------------------------------*/
+    if( tcgetattr( STDIN_FILENO, &savedTio ) == 0 )
+    {
+        rawTio                  = savedTio;
+        rawTio.c_lflag         &= ~( (tcflag_t)( ICANON | ECHO ) );
+        rawTio.c_cc[ VMIN ]     = 1;
+        rawTio.c_cc[ VTIME ]    = 0;
+        if( tcsetattr( STDIN_FILENO, TCSANOW, &rawTio ) == 0 )
+        {
+            rawMode = TRUE;
+        }
+    }
+
+    /* Make sure the buffer can hold a small line before bytes arrive. */
+    if( *n < 128 )
+    {
+        *n   = 128;
+        *buf = realloc( *buf, *n );
+        if( *buf == NULL )
+        {
+            fprintf( stderr, "Failed to grow input buffer\n" );
+            exit( EXIT_FAILURE );
+        }
+    }
+
+    /*-----------------------------------------------------------------------
+     * Block on stdin and the SIGCHLD self-pipe together. Child exits wake
+     * the poll, get reaped on the spot, and the prompt is reissued; a
+     * readable stdin drops through to the byte read below.
+     *---------------------------------------------------------------------*/
+    for(;;)
+    {
+        pollFds[ 0 ].fd      = STDIN_FILENO;
+        pollFds[ 0 ].events  = POLLIN;
+        pollFds[ 1 ].fd      = sigChldPipe[ 0 ];
+        pollFds[ 1 ].events  = POLLIN;
+
+        if( poll( pollFds, 2, -1 ) == -1 )
+        {
+            /* Interrupted by a signal; just re-poll. */
+            if( errno == EINTR )
+            {
+                continue;
+            }
+            break;
+        }
+
+        /*-------------------------------------------------------------------
+         * The self-pipe woke the wait: a child died, or SIGTSTP recorded a
+         * mode change. Reap anything pending, then reissue the prompt -
+         * PromptFlush folds any mode-change notice into the same writev.
+         *-------------------------------------------------------------------*/
+        if( pollFds[ 1 ].revents & POLLIN )
+        {
+            DrainChildEvents();
+            PromptFlush();
+            /* Re-echo whatever was typed before the interruption. */
+            if( rawMode == TRUE && len > 0 )
+            {
+                if( write( STDOUT_FILENO, *buf, len ) == -1 )
+                {
+                    ;
+                }
+            }
+        }
+
+        if( ( pollFds[ 0 ].revents & ( POLLIN | POLLHUP ) ) == 0 )
+        {
+            continue;
+        }
+
+        /* No terminal control: one blocking getline finishes the read. */
+        if( rawMode == FALSE )
+        {
+            if( getline( buf, n, stdin ) == -1 )
+            {
+                /* End of input; leave like an exit command would. */
+                MyExit( NULL );
+            }
+            return( EXIT_SUCCESS );
+        }
+
+        nRead = read( STDIN_FILENO, &ch, 1 );
+        if( nRead == -1 && errno == EINTR )
+        {
+            continue;
+        }
+        if( nRead <= 0 || ( ch == 0x04 && len == 0 ) )
+        {
+            /* EOF or Ctrl-D on an empty line; leave like exit would. */
+            if( len == 0 )
+            {
+                tcsetattr( STDIN_FILENO, TCSANOW, &savedTio );
+                MyExit( NULL );
+            }
+            break;
+        }
+
+        if( ch == '\n' || ch == '\r' )
+        {
+            if( write( STDOUT_FILENO, "\n", 1 ) == -1 )
+            {
+                ;
+            }
+            break;
+        }
+        else if( ch == '\t' )
+        {
+            CompleteToken( buf, n, &len );
+        }
+        else if( ch == 0x7F || ch == '\b' )
+        {
+            if( len > 0 )
+            {
+                len -= 1;
+                if( write( STDOUT_FILENO, "\b \b", 3 ) == -1 )
+                {
+                    ;
+                }
+            }
+        }
+        else if( (unsigned char)ch >= 0x20 )
+        {
+            if( len + 3 > *n )
+            {
+                *n  *= 2;
+                *buf = realloc( *buf, *n );
+                if( *buf == NULL )
+                {
+                    fprintf( stderr, "Failed to grow input buffer\n" );
+                    exit( EXIT_FAILURE );
+                }
+            }
+            ( *buf )[ len ] = ch;
+            len += 1;
+            if( write( STDOUT_FILENO, &ch, 1 ) == -1 )
+            {
+                ;
+            }
+        }
+        /* Remaining control bytes (arrow keys and friends) are ignored. */
+    }
+
+    /* Keep the historical contract: the newline stays on the line. */
+    ( *buf )[ len ]     = '\n';
+    ( *buf )[ len + 1 ] = '\0';
+
+    if( rawMode == TRUE )
+    {
+        tcsetattr( STDIN_FILENO, TCSANOW, &savedTio );
+    }
+
+    return( EXIT_SUCCESS );
+
+} /* end - GetInput() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      GlobCompareName
+ *
+ * DESCRIPTION
+ *      qsort comparator ordering glob matches alphabetically.
+ *
+ ****************************************************************************/
+
+static int GlobCompareName
+    (
+    const void         *a,              /* First name to compare            */
+    const void         *b               /* Second name to compare           */
+    )
+{
+    return( strcmp( *(char *const *)a, *(char *const *)b ) );
+
+} /* end - GlobCompareName() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      GlobExpand
+ *
+ * DESCRIPTION
+ *      This function expands one glob pattern into the command's args
+ *      array. The pattern's directory part is listed through the cached
+ *      scan engine, its base part is matched against every entry, and
+ *      the sorted matches are built as arena strings exactly like other
+ *      expanded tokens. Hidden files only match patterns that name the
+ *      leading dot. A pattern matching nothing is kept literally, the
+ *      way exec would have received it before.
+ *
+ * NOTES
+ *      Returns the updated argument count. Expansion stops quietly when
+ *      the args array is full.
+ *
+ ****************************************************************************/
+
+static int GlobExpand
+    (
+    char               *pattern,        /* The glob pattern to expand       */
+    cmdStruct          *command,        /* The command receiving matches    */
+    int                 argCount        /* Current count of stored args     */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    const char     *lp_base;
+    char           *lp_dir;
+    globDirEntry   *lp_entry;
+    char           *lp_expanded;
+    char           *lp_slash;
+    char           *matches[ MAX_ARGS ];
+    size_t          nameLen;
+    size_t          numMatches;
+    size_t          prefixLen;
+
+    /******************************
+    *  INITIALIZE VARIABLES
+    ******************************/
+    numMatches  = 0;
+    lp_slash    = strrchr( pattern, '/' );
+
+    /* Split the pattern into its directory and base parts. */
+    if( lp_slash != NULL )
+    {
+        prefixLen = ( lp_slash - pattern ) + 1;
+        lp_base   = lp_slash + 1;
+        /* NUL-terminated copy of the directory part, slash included. */
+        lp_dir    = UTL_ArenaAlloc( prefixLen + 1 );
+        memcpy( lp_dir, pattern, prefixLen );
+    }
+    else
+    {
+        prefixLen = 0;
+        lp_base   = pattern;
+        lp_dir    = ".";
+    }
+
+    /* List the directory and collect every matching entry. */
+    lp_entry = GlobScanDir( lp_dir );
+    if( lp_entry != NULL )
+    {
+        for( size_t i = 0; i < lp_entry->numNames; i++ )
+        {
+            /* Hidden files only match patterns naming the leading dot. */
+            if( lp_entry->names[ i ][ 0 ] == '.' && lp_base[ 0 ] != '.' )
+            {
+                continue;
+            }
+            if( numMatches < MAX_ARGS && GlobMatch( lp_base, lp_entry->names[ i ] ) )
+            {
+                matches[ numMatches ] = lp_entry->names[ i ];
+                numMatches += 1;
+            }
+        }
+    }
+
+    /* No matches: keep the pattern literally, as exec saw it before. */
+    if( numMatches == 0 )
+    {
+        if( argCount < MAX_ARGS - 1 )
+        {
+            command->args[ argCount ] = pattern;
+            argCount += 1;
+        }
+
+        return( argCount );
+    }
+
+    qsort( matches, numMatches, sizeof( char * ), GlobCompareName );
+
+    /* Store each match as directory part plus entry name, in the arena. */
+    for( size_t i = 0; i < numMatches && argCount < MAX_ARGS - 1; i++ )
+    {
+        nameLen     = strlen( matches[ i ] );
+        lp_expanded = UTL_ArenaAlloc( prefixLen + nameLen + 1 );
+        memcpy( lp_expanded, pattern, prefixLen );
+        memcpy( lp_expanded + prefixLen, matches[ i ], nameLen );
+
+        command->args[ argCount ] = lp_expanded;
+        argCount += 1;
+    }
+
+    return( argCount );
+
+} /* end - GlobExpand() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      GlobMatch
+ *
+ * DESCRIPTION
+ *      This function tests a file name against a glob pattern where '*'
+ *      matches any run of characters and '?' matches any one character.
+ *      Iterative with single-star backtracking, so no recursion and no
+ *      allocation per test.
+ *
+ ****************************************************************************/
+
+static bool GlobMatch
+    (
+    const char         *pattern,        /* The pattern, with * and ?        */
+    const char         *name            /* The file name to test            */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    const char *lp_backtrack;
+    const char *lp_star;
+
+    /******************************
+    *  INITIALIZE VARIABLES
+    ******************************/
+    lp_backtrack    = NULL;
+    lp_star         = NULL;
+
+    while( *name != '\0' )
+    {
+        /* Star: remember where to resume if the tail fails to match. */
+        if( *pattern == '*' )
+        {
+            pattern      += 1;
+            lp_star       = pattern;
+            lp_backtrack  = name;
+        }
+        /* Literal or single-character match: consume both. */
+        else if( *pattern == '?' || *pattern == *name )
+        {
+            pattern += 1;
+            name    += 1;
+        }
+        /* Mismatch: widen the last star by one character and retry. */
+        else if( lp_star != NULL )
+        {
+            lp_backtrack += 1;
+            pattern       = lp_star;
+            name          = lp_backtrack;
+        }
+        else
+        {
+            return( FALSE );
+        }
+    }
+
+    /* Trailing stars match the empty tail. */
+    while( *pattern == '*' )
+    {
+        pattern += 1;
+    }
+
+    return( *pattern == '\0' );
+
+} /* end - GlobMatch() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      GlobScanDir
+ *
+ * DESCRIPTION
+ *      This function returns the entry listing of a directory through the
+ *      glob cache. A hit whose (dev, inode, mtime) key still matches the
+ *      directory costs one stat and no directory reads at all; otherwise
+ *      the directory is listed with batched getdents64 reads into a
+ *      reusable buffer, packed into a fresh blob, and cached in place of
+ *      the round-robin victim.
+ *
+ * NOTES
+ *      Returns NULL when the directory cannot be statted or opened.
+ *
+ ****************************************************************************/
+
+static globDirEntry *GlobScanDir
+    (
+    const char         *path            /* The directory to list            */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    static char     dentBuf[ GLOB_DENT_BUF ];
+    size_t          blobCap;
+    ssize_t         dentLen;
+    struct stat     dirStat;
+    int             fd;
+    linuxDirent64  *lp_dent;
+    globDirEntry   *lp_entry;
+    size_t          nameLen;
+    size_t          off;
+
+    /******************************
+    *  INITIALIZE VARIABLES
+    ******************************/
+    lp_entry    = NULL;
+
+    if( stat( path, &dirStat ) == -1 )
+    {
+        return( NULL );
+    }
+
+    /* Probe the cache for this directory. */
+    for( size_t i = 0; i < GLOB_CACHE_SIZE; i++ )
+    {
+        if( globCache[ i ].path != NULL && strcmp( globCache[ i ].path, path ) == 0 )
+        {
+            lp_entry = &globCache[ i ];
+            break;
+        }
+    }
+
+    /* Fresh hit: the listing is still current, no rescan needed. */
+    if( lp_entry != NULL
+     && lp_entry->dev == dirStat.st_dev
+     && lp_entry->ino == dirStat.st_ino
+     && lp_entry->mtime.tv_sec  == dirStat.st_mtim.tv_sec
+     && lp_entry->mtime.tv_nsec == dirStat.st_mtim.tv_nsec )
+    {
+        return( lp_entry );
+    }
+
+    fd = open( path, O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+    if( fd == -1 )
+    {
+        return( NULL );
+    }
+
+    /* Claim the stale hit, or evict the round-robin victim. */
+    if( lp_entry == NULL )
+    {
+        lp_entry       = &globCache[ globCacheNext ];
+        globCacheNext  = ( globCacheNext + 1 ) % GLOB_CACHE_SIZE;
+        free( lp_entry->path );
+        lp_entry->path = strdup( path );
+    }
+    free( lp_entry->blob );
+    free( lp_entry->names );
+    lp_entry->blob     = NULL;
+    lp_entry->blobLen  = 0;
+    lp_entry->names    = NULL;
+    lp_entry->numNames = 0;
+
+    lp_entry->dev   = dirStat.st_dev;
+    lp_entry->ino   = dirStat.st_ino;
+    lp_entry->mtime = dirStat.st_mtim;
+
+    /*----------------------------------------------------------------
+     * List the directory with batched getdents64 reads, packing each
+     * name NUL-terminated into the blob. The . and .. entries are
+     * dropped here so matching never sees them.
+     *--------------------------------------------------------------*/
+    blobCap = 0;
+    for(;;)
+    {
+        dentLen = syscall( SYS_getdents64, fd, dentBuf, sizeof( dentBuf ) );
+        if( dentLen <= 0 )
+        {
+            break;
+        }
+
+        for( off = 0; off < (size_t)dentLen; off += lp_dent->d_reclen )
+        {
+            lp_dent = (linuxDirent64 *)( dentBuf + off );
+            if( strcmp( lp_dent->d_name, "." ) == 0
+             || strcmp( lp_dent->d_name, ".." ) == 0 )
+            {
+                continue;
+            }
+
+            nameLen = strlen( lp_dent->d_name );
+            if( lp_entry->blobLen + nameLen + 1 > blobCap )
+            {
+                blobCap = ( blobCap == 0 ) ? 4096 : blobCap * 2;
+                lp_entry->blob = realloc( lp_entry->blob, blobCap );
+                if( lp_entry->blob == NULL )
+                {
+                    fprintf( stderr, "Failed to allocate glob listing\n" );
+                    exit( EXIT_FAILURE );
+                }
+            }
+
+            memcpy( lp_entry->blob + lp_entry->blobLen, lp_dent->d_name, nameLen + 1 );
+            lp_entry->blobLen  += nameLen + 1;
+            lp_entry->numNames += 1;
+        }
+    }
+    close( fd );
+
+    /* Build the index over the packed names. */
+    lp_entry->names = malloc( lp_entry->numNames * sizeof( char * ) );
+    if( lp_entry->names == NULL && lp_entry->numNames > 0 )
+    {
+        fprintf( stderr, "Failed to allocate glob index\n" );
+        exit( EXIT_FAILURE );
+    }
+    off = 0;
+    for( size_t i = 0; i < lp_entry->numNames; i++ )
+    {
+        lp_entry->names[ i ] = lp_entry->blob + off;
+        off += strlen( lp_entry->blob + off ) + 1;
+    }
+
+    return( lp_entry );
+
+} /* end - GlobScanDir() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      HandleSIGCHLD
+ *
+ * DESCRIPTION
+ *      This is the signal handler for SIGCHLD signals for the parent process.
+ *      When the shell is idle it reaps each exited child right here with
+ *      wait4 and pushes a (pid, status, rusage) record into the lock-free
+ *      exit ring, so no status is ever collapsed into a flag and ReapZombies
+ *      does O(exits) work instead of a rescan. While a command list or
+ *      foreground wait is in progress the handler only flags a deferred
+ *      pass, leaving the zombies to the engines' targeted wait4 calls.
+ *      Either way a wakeup byte goes down the self-pipe, which the input
+ *      wait in GetInput polls, so exits surface even while blocked at the
+ *      prompt.
+ *
+ ****************************************************************************/
+
+static void HandleSIGCHLD
+    (
+    int                 signum          /* The signal number                */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    sig_atomic_t    next;
+    pid_t           pid;
+    int             savedErrno;
+    int             status;
+    struct rusage   usage;
+
+    /******************************
+    *  INITIALIZE VARIABLES
+    ******************************/
+    savedErrno  = errno;
+
+    /*---------------------------------------------------------------
+     * While the command engines are running, their targeted wait4
+     * calls own the reaping; stealing a child here would surface as
+     * ECHILD over there. Leave the zombies and flag the deferred
+     * pass instead.
+     *-------------------------------------------------------------*/
+    if( foregroundChild == TRUE || reapHold == TRUE )
+    {
+        chldDeferred = TRUE;
+    }
+    else
+    {
+        /* Push one (pid, status, rusage) record per exited child. */
+        for(;;)
+        {
+            next = ( chldRingHead + 1 ) & ( CHLD_RING_SIZE - 1 );
+            if( next == chldRingTail )
+            {
+                /* Ring full; leave the rest for the deferred pass. */
+                chldDeferred = TRUE;
+                break;
+            }
+
+            pid = wait4( -1, &status, WNOHANG, &usage );
+            if( pid <= 0 )
+            {
+                break;
+            }
+
+            chldRing[ chldRingHead ].pid    = pid;
+            chldRing[ chldRingHead ].status = status;
+            chldRing[ chldRingHead ].usage  = usage;
+            chldRingHead = next;
+        }
+    }
+
+    /*---------------------------------------------------------------
+     * Wake the input wait. The pipe is non-blocking, so a full pipe
+     * (wakeup already pending) is fine to ignore.
+     *-------------------------------------------------------------*/
+    if( write( sigChldPipe[ 1 ], "c", 1 ) == -1 )
+    {
+        ;
+    }
+
+    errno = savedErrno;
+
+    /* Appease compiler warning. */
+    if( signum )
+    {
+        ;
+    }
+} /* end - HandleSIGCHLD() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      HandleSIGTSTP
+ *
+ * DESCRIPTION
+ *      This is the signal handler for SIGTSTP. It toggles background mode
+ *      and records which notice the user is owed; the prompt composer
+ *      reads and clears the flag at the next prompt boundary, so the
+ *      handler writes no message text from signal context. The self-pipe
+ *      poke wakes an input wait so a shell sitting at the prompt shows the
+ *      notice immediately; with a foreground child running the notice
+ *      waits for the next prompt, as before.
+ *
+ ****************************************************************************/
+
+static void HandleSIGTSTP
+    (
+    int                 signum          /* The signal number                */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    int     savedErrno;
+
+    /******************************
+    *  INITIALIZE VARIABLES
+    ******************************/
+    savedErrno  = errno;
+
+    /* Toggle the mode and record which notice the composer should show. */
+    if( ignoreBackground == FALSE )
+    {
+        ignoreBackground    = TRUE;
+        backgroundIgnoreSet = TRUE;
+    }
+    else
+    {
+        ignoreBackground      = FALSE;
+        backgroundUnignoreSet = TRUE;
+    }
+
+    /*---------------------------------------------------------------
+     * Wake the input wait. The pipe is non-blocking, so a full pipe
+     * (wakeup already pending) is fine to ignore.
+     *-------------------------------------------------------------*/
+    if( write( sigChldPipe[ 1 ], "c", 1 ) == -1 )
+    {
+        ;
+    }
+
+    errno = savedErrno;
+
+    /* Appease compiler warning. */
+    if( signum )
+    {
+        ;
+    }
+
+} /* end - HandleSIGTSTP() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      HandleSIGUSR1
+ *
+ * DESCRIPTION
+ *      This is the signal handler for SIGUSR1. It dumps the in-memory trace
+ *      ring to a file for post-mortem inspection, so a wedged or misbehaving
+ *      shell can be asked for its recent history without being restarted.
+ *      UTL_TraceDump only calls open, write, and close, all of which are
+ *      async-signal-safe.
+ *
+ ****************************************************************************/
+
+static void HandleSIGUSR1
+    (
+    int                 signum          /* The signal number                */
+    )
+{
+    UTL_TraceDump();
+
+    /* Appease compiler warning. */
+    if( signum )
+    {
+        ;
+    }
+
+} /* end - HandleSIGUSR1() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      HashString
+ *
+ * DESCRIPTION
+ *      This function hashes a string using the FNV-1a hash function. Used to
+ *      index the PATH resolution cache.
+ *
+ ****************************************************************************/
+
+static unsigned long HashString
+    (
+    const char         *str             /* The string to hash               */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    unsigned long   hash;
+
+    /******************************
+    *  INITIALIZE VARIABLES
+    ******************************/
+    hash        = 2166136261ul;
+
+    /* Fold each byte of the string into the hash. */
+    while( *str != '\0' )
+    {
+        hash ^= (unsigned char)*str;
+        hash *= 16777619ul;
+        str += 1;
+    }
+
+    return( hash );
+
+} /* end - HashString() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      HereStringFd
+ *
+ * DESCRIPTION
+ *      This function materializes a here-string payload as an anonymous
+ *      memfd: the payload plus a trailing newline is written into it, the
+ *      contents are sealed against any further change, and the offset is
+ *      rewound so the fd reads like a just-opened input file. No disk I/O
+ *      happens at any point, unlike the temp-file dance this replaces.
+ *
+ * NOTES
+ *      Returns the fd, or -1 with a message on stderr. The caller owns
+ *      the fd; ResetCommand and ParseCommand close it when the command
+ *      is done with it.
+ *
+ ****************************************************************************/
+
+static int HereStringFd
+    (
+    const char         *payload         /* The here-string body             */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    int         fd;
+    size_t      payloadLen;
+
+    fd = memfd_create( "smallsh-here", MFD_CLOEXEC | MFD_ALLOW_SEALING );
+    if( fd == -1 )
+    {
+        fprintf( stderr, "cannot create here-string buffer\n" );
+        return( -1 );
+    }
+
+    payloadLen = strlen( payload );
+    if( write( fd, payload, payloadLen ) != (ssize_t)payloadLen
+     || write( fd, "\n", 1 ) != 1 )
+    {
+        fprintf( stderr, "cannot write here-string buffer\n" );
+        close( fd );
+        return( -1 );
+    }
+
+    /* Seal the payload; nothing can grow, shrink, or rewrite it now. */
+    fcntl( fd, F_ADD_SEALS, F_SEAL_GROW | F_SEAL_SHRINK | F_SEAL_WRITE | F_SEAL_SEAL );
+
+    lseek( fd, 0, SEEK_SET );
+
+    return( fd );
+
+} /* end - HereStringFd() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      HistoryAppend
+ *
+ * DESCRIPTION
+ *      This function records one command line in the history: it is copied
+ *      into the in-memory ring and appended to the mmap window over the
+ *      log file. Appends are plain memcpys into the mapping; an msync is
+ *      issued only every HIST_SYNC_EVERY entries, so the log costs neither
+ *      a write nor an fsync per command. Blank lines are not recorded.
+ *
+ ****************************************************************************/
+
+static int HistoryAppend
+    (
+    const char         *line            /* The command line to record       */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    size_t      len;
+    size_t      newCap;
+    size_t      slot;
+
+    HistoryLoad();
+
+    /* Measure the line without its trailing newline. */
+    len = strlen( line );
+    while( len > 0 && line[ len - 1 ] == '\n' )
+    {
+        len -= 1;
+    }
+    if( len == 0 )
+    {
+        return( EXIT_SUCCESS );
+    }
+
+    /* Append to the log through the mmap window. */
+    if( histMap != NULL )
+    {
+        /* Grow the window when the line does not fit. */
+        if( histFileLen + len + 1 > histMapSize )
+        {
+            newCap = histMapSize;
+            while( histFileLen + len + 1 > newCap )
+            {
+                newCap += HIST_MAP_CHUNK;
+            }
+
+            munmap( histMap, histMapSize );
+            histMap = NULL;
+            if( ftruncate( histFd, newCap ) == 0 )
+            {
+                histMap = mmap( NULL, newCap, PROT_READ | PROT_WRITE,
+                                MAP_SHARED, histFd, 0 );
+            }
+            /* Growth failure: keep the session ring, drop the log. */
+            if( histMap == MAP_FAILED || histMap == NULL )
+            {
+                histMap = NULL;
+                close( histFd );
+                histFd = -1;
+            }
+            else
+            {
+                histMapSize = newCap;
+            }
+        }
+
+        if( histMap != NULL )
+        {
+            memcpy( histMap + histFileLen, line, len );
+            histMap[ histFileLen + len ] = '\n';
+            histFileLen += len + 1;
+
+            /* Batch durability: one msync per HIST_SYNC_EVERY appends. */
+            histDirty += 1;
+            if( histDirty >= HIST_SYNC_EVERY )
+            {
+                msync( histMap, histFileLen, MS_ASYNC );
+                histDirty = 0;
+            }
+        }
+    }
+
+    /* Record the line in the recall ring. */
+    slot = histCount % HIST_RING_SIZE;
+    free( histRing[ slot ] );
+    histRing[ slot ] = strndup( line, len );
+    histCount += 1;
+
+    return( EXIT_SUCCESS );
+
+} /* end - HistoryAppend() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      HistoryExpand
+ *
+ * DESCRIPTION
+ *      This function expands history recalls: a line starting '!!' becomes
+ *      the previous command and '!n' becomes history entry n, either way
+ *      with any trailing text carried over. The expansion is built in the
+ *      per-command arena and echoed so the user sees what will run. Lines
+ *      that are not recalls pass through untouched.
+ *
+ * NOTES
+ *      A failed recall prints a diagnostic and returns a blank line, which
+ *      the dispatcher skips.
+ *
+ ****************************************************************************/
+
+static char *HistoryExpand
+    (
+    char               *line            /* The input line, maybe a recall   */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    char       *lp_new;
+    char       *lp_recall;
+    char       *lp_rest;
+    size_t      number;
+    size_t      recallLen;
+    size_t      restLen;
+
+    /* Not a recall; pass the line through. */
+    if( line[ 0 ] != '!' )
+    {
+        return( line );
+    }
+
+    HistoryLoad();
+
+    /* '!!' recalls the previous command, '!n' recalls entry n. */
+    if( line[ 1 ] == '!' )
+    {
+        number  = histCount;
+        lp_rest = line + 2;
+    }
+    else
+    {
+        number  = strtoul( line + 1, &lp_rest, 10 );
+    }
+
+    /* The entry must still be inside the recall ring's window. */
+    if( number < 1 || number > histCount
+     || histCount - number >= HIST_RING_SIZE
+     || histRing[ ( number - 1 ) % HIST_RING_SIZE ] == NULL )
+    {
+        UTL_FlushedPrintOut( "history: event not found\n" );
+        lp_new      = UTL_ArenaAlloc( 1 );
+        lp_new[ 0 ] = '\0';
+
+        return( lp_new );
+    }
+
+    lp_recall = histRing[ ( number - 1 ) % HIST_RING_SIZE ];
+    recallLen = strlen( lp_recall );
+
+    /* Carry any text after the recall, minus the trailing newline. */
+    restLen = strlen( lp_rest );
+    while( restLen > 0 && lp_rest[ restLen - 1 ] == '\n' )
+    {
+        restLen -= 1;
+    }
+
+    lp_new = UTL_ArenaAlloc( recallLen + restLen + 1 );
+    memcpy( lp_new, lp_recall, recallLen );
+    memcpy( lp_new + recallLen, lp_rest, restLen );
+    lp_new[ recallLen + restLen ] = '\0';
+
+    /* Echo the expansion so the user sees what will run. */
+    UTL_FlushedPrintOut( "%s\n", lp_new );
+
+    return( lp_new );
+
+} /* end - HistoryExpand() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      HistoryLoad
+ *
+ * DESCRIPTION
+ *      This function lazily attaches the history subsystem on first use:
+ *      it opens (creating if needed) the log file under HOME, maps it
+ *      shared with chunk-granular headroom for appends, and seeds the
+ *      recall ring with the file's most recent lines in one memchr walk.
+ *      Nothing here runs at startup, so interactive launch time stays
+ *      flat regardless of how many entries the log holds.
+ *
+ * NOTES
+ *      NUL padding left by a session that never trimmed its preallocated
+ *      tail is detected and skipped. Without HOME (or on any map failure)
+ *      history degrades to the in-memory ring alone.
+ *
+ ****************************************************************************/
+
+static int HistoryLoad(void)
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    size_t      cap;
+    size_t      end;
+    size_t      len;
+    struct stat histStat;
+    char       *lp_home;
+    char       *lp_newline;
+    char       *lp_scan;
+    char        path[ PATH_MAX_LEN ];
+    size_t      slot;
+
+    if( histLoaded == TRUE )
+    {
+        return( EXIT_SUCCESS );
+    }
+    histLoaded = TRUE;
+
+    lp_home = getenv( HOME_ENV );
+    if( lp_home == NULL )
+    {
+        return( EXIT_FAILURE );
+    }
+    snprintf( path, sizeof( path ), "%s/%s", lp_home, HIST_FILE );
+
+    histFd = open( path, O_RDWR | O_CREAT | O_CLOEXEC, 0600 );
+    if( histFd == -1 )
+    {
+        return( EXIT_FAILURE );
+    }
+
+    fstat( histFd, &histStat );
+    end = histStat.st_size;
+
+    /* Map with chunk-granular headroom so appends need no remap. */
+    cap = ( ( end / HIST_MAP_CHUNK ) + 1 ) * HIST_MAP_CHUNK;
+    if( ftruncate( histFd, cap ) == -1
+     || ( histMap = mmap( NULL, cap, PROT_READ | PROT_WRITE,
+                          MAP_SHARED, histFd, 0 ) ) == MAP_FAILED )
+    {
+        histMap = NULL;
+        close( histFd );
+        histFd = -1;
+
+        return( EXIT_FAILURE );
+    }
+    histMapSize = cap;
+
+    /* Skip NUL padding left by a session that never trimmed its tail. */
+    while( end > 0 && histMap[ end - 1 ] == '\0' )
+    {
+        end -= 1;
+    }
+    histFileLen = end;
+
+    /* Seed the recall ring; the file's last HIST_RING_SIZE lines survive. */
+    lp_scan = histMap;
+    while( lp_scan < histMap + end )
+    {
+        lp_newline = memchr( lp_scan, '\n', ( histMap + end ) - lp_scan );
+        len = ( lp_newline != NULL ) ? (size_t)( lp_newline - lp_scan )
+                                     : (size_t)( ( histMap + end ) - lp_scan );
+        if( len > 0 )
+        {
+            slot = histCount % HIST_RING_SIZE;
+            free( histRing[ slot ] );
+            histRing[ slot ] = strndup( lp_scan, len );
+            histCount += 1;
+        }
+        lp_scan += len + 1;
+    }
+
+    return( EXIT_SUCCESS );
+
+} /* end - HistoryLoad() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      JobHashDelete
+ *
+ * DESCRIPTION
+ *      This function removes a pid from the job hash index, leaving a
+ *      tombstone so later probe sequences stay intact. Returns the job
+ *      table slot the pid occupied, or -1 if the pid was not indexed.
+ *
+ ****************************************************************************/
+
+static int JobHashDelete
+    (
+    pid_t               pid             /* The pid to remove from the index */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    size_t      idx;
+    int         slot;
+
+    if( jobHashSize == 0 )
+    {
+        return( -1 );
+    }
+
+    /* Probe until the pid or an empty entry is found. */
+    idx = ( (size_t)pid * 2654435761ul ) & ( jobHashSize - 1 );
+    while( jobHash[ idx ].pid != 0 )
+    {
+        if( jobHash[ idx ].pid == pid )
+        {
+            slot = jobHash[ idx ].slot;
+            /* Leave a tombstone so other probe chains keep working. */
+            jobHash[ idx ].pid  = -1;
+            jobHashTombstones  += 1;
+
+            return( slot );
+        }
+        idx = ( idx + 1 ) & ( jobHashSize - 1 );
+    }
+
+    return( -1 );
+
+} /* end - JobHashDelete() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      JobHashFind
+ *
+ * DESCRIPTION
+ *      This function looks a pid up in the job hash index without
+ *      modifying it. Returns the job table slot the pid occupies, or -1
+ *      if the pid is not being tracked.
+ *
+ ****************************************************************************/
+
+static int JobHashFind
+    (
+    pid_t               pid             /* The pid to look up               */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    size_t      idx;
+
+    if( jobHashSize == 0 )
+    {
+        return( -1 );
+    }
+
+    /* Probe until the pid or an empty entry is found. */
+    idx = ( (size_t)pid * 2654435761ul ) & ( jobHashSize - 1 );
+    while( jobHash[ idx ].pid != 0 )
+    {
+        if( jobHash[ idx ].pid == pid )
+        {
+            return( jobHash[ idx ].slot );
+        }
+        idx = ( idx + 1 ) & ( jobHashSize - 1 );
+    }
+
+    return( -1 );
+
+} /* end - JobHashFind() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      JobHashInsert
+ *
+ * DESCRIPTION
+ *      This function indexes a pid to its job table slot in the hash
+ *      index, reusing tombstoned entries. When tombstones have accumulated
+ *      past half the index, the index is rebuilt clean.
+ *
+ ****************************************************************************/
+
+static int JobHashInsert
+    (
+    pid_t               pid,            /* The pid to index                 */
+    int                 slot            /* The job table slot it occupies   */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    size_t      idx;
+
+    /* Rebuild the index when tombstones crowd out live entries. */
+    if( jobHashTombstones > jobHashSize / 2 )
+    {
+        JobHashRebuild( jobHashSize );
+    }
+
+    /* Probe for the first empty or tombstoned entry. */
+    idx = ( (size_t)pid * 2654435761ul ) & ( jobHashSize - 1 );
+    while( jobHash[ idx ].pid != 0 && jobHash[ idx ].pid != -1 )
+    {
+        idx = ( idx + 1 ) & ( jobHashSize - 1 );
+    }
+
+    if( jobHash[ idx ].pid == -1 )
+    {
+        jobHashTombstones -= 1;
+    }
+
+    jobHash[ idx ].pid  = pid;
+    jobHash[ idx ].slot = slot;
+
+    return( EXIT_SUCCESS );
+
+} /* end - JobHashInsert() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      JobHashRebuild
+ *
+ * DESCRIPTION
+ *      This function rebuilds the pid-to-slot hash index at the given
+ *      size (a power of two) from the live entries of the job table,
+ *      clearing out any accumulated tombstones. Exits with failure if the
+ *      index could not be allocated.
+ *
+ ****************************************************************************/
+
+static int JobHashRebuild
+    (
+    size_t              newSize         /* New index size (power of two)    */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    size_t      idx;
+
+    free( jobHash );
+    jobHash = calloc( newSize, sizeof( jobHashEntry ) );
+    if( jobHash == NULL )
+    {
+        fprintf( stderr, "Failed to allocate job hash index\n" );
+        exit( EXIT_FAILURE );
+    }
+    jobHashSize         = newSize;
+    jobHashTombstones   = 0;
+
+    /* Re-index every live job table slot. */
+    for( size_t i = 0; i < jobTableSize; i++ )
+    {
+        if( jobTable[ i ].pid != 0 )
+        {
+            idx = ( (size_t)jobTable[ i ].pid * 2654435761ul ) & ( jobHashSize - 1 );
+            while( jobHash[ idx ].pid != 0 )
+            {
+                idx = ( idx + 1 ) & ( jobHashSize - 1 );
+            }
+            jobHash[ idx ].pid  = jobTable[ i ].pid;
+            jobHash[ idx ].slot = (int)i;
+        }
+    }
+
+    return( EXIT_SUCCESS );
+
+} /* end - JobHashRebuild() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      JobRecordAdd
+ *
+ * DESCRIPTION
+ *      This function appends one finished job to the rolling record ring:
+ *      pid, exit status, wall time measured against the launch timestamp
+ *      cached in the job table, and the CPU times and peak RSS captured
+ *      by wait4. Must be called before RemoveChildPid frees the job's
+ *      table slot. The ring overwrites its oldest record once full.
+ *
+ ****************************************************************************/
+
+static int JobRecordAdd
+    (
+    pid_t               pid,            /* The pid that just finished       */
+    int                 status,         /* Its raw wait status              */
+    struct rusage      *usage           /* Its rusage captured by wait4     */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    jobRecord      *lp_rec;
+    struct timespec now;
+    int             slot;
+
+    /******************************
+    *  INITIALIZE VARIABLES
+    ******************************/
+    lp_rec      = &jobRing[ jobRingNext ];
+    slot        = JobHashFind( pid );
+
+    lp_rec->pid      = pid;
+    lp_rec->status   = status;
+    lp_rec->userTime = usage->ru_utime;
+    lp_rec->sysTime  = usage->ru_stime;
+    lp_rec->maxRss   = usage->ru_maxrss;
+
+    /* Wall time and name come from the job's still-live table slot. */
+    if( slot != -1 )
+    {
+        clock_gettime( CLOCK_MONOTONIC, &now );
+        lp_rec->wallNs = ( now.tv_sec - jobTable[ slot ].start.tv_sec )
+                       * (unsigned long long)NSEC_PER_SEC
+                       + ( now.tv_nsec - jobTable[ slot ].start.tv_nsec );
+        snprintf( lp_rec->name, JOB_NAME_LEN, "%s", jobTable[ slot ].name );
+    }
+    else
+    {
+        lp_rec->wallNs    = 0;
+        lp_rec->name[ 0 ] = '\0';
+    }
+
+    jobRingNext = ( jobRingNext + 1 ) % JOB_RING_SIZE;
+    if( jobRingCount < JOB_RING_SIZE )
+    {
+        jobRingCount += 1;
+    }
+
+    return( EXIT_SUCCESS );
+
+} /* end - JobRecordAdd() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      JobTableGrow
+ *
+ * DESCRIPTION
+ *      This function doubles the capacity of the job table (allocating it
+ *      on first use), threads the new slots onto the free list, and
+ *      rebuilds the hash index at four times the new capacity so probe
+ *      chains stay short. Exits with failure on allocation failure.
+ *
+ ****************************************************************************/
+
+static int JobTableGrow(void)
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    size_t      newSize;
+
+    /******************************
+    *  INITIALIZE VARIABLES
+    ******************************/
+    newSize     = ( jobTableSize == 0 ) ? JOB_TABLE_INIT : jobTableSize * 2;
+
+    jobTable = realloc( jobTable, newSize * sizeof( jobSlot ) );
+    if( jobTable == NULL )
+    {
+        fprintf( stderr, "Failed to allocate job table\n" );
+        exit( EXIT_FAILURE );
+    }
+
+    /* Thread the new slots onto the free list. */
+    for( size_t i = newSize; i > jobTableSize; i-- )
+    {
+        jobTable[ i - 1 ].pid      = 0;
+        jobTable[ i - 1 ].nextFree = jobFreeHead;
+        jobFreeHead                = (int)( i - 1 );
+    }
+
+    jobTableSize = newSize;
+
+    /* Size the index at 4x capacity to keep load factor low. */
+    JobHashRebuild( newSize * 4 );
+
+    return( EXIT_SUCCESS );
+
+} /* end - JobTableGrow() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      MyAlias
+ *
+ * DESCRIPTION
+ *      This function performs the built-in 'alias' command. With no
+ *      arguments it lists the defined aliases; otherwise 'alias NAME=word
+ *      [word ...]' defines NAME to expand to the given words. The
+ *      replacement is captured pre-tokenized, straight from this command's
+ *      own argument vector.
+ *
+ ****************************************************************************/
+
+static int MyAlias
+    (
+    cmdStruct          *command         /* The command containing alias     */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    char       *lp_eq;
+    char       *lp_name;
+    int         numTokens;
+
+    /* No arguments: list every alias. */
+    if( command->args[ 1 ] == NULL )
+    {
+        for( size_t i = 0; i < ALIAS_TABLE_SIZE; i++ )
+        {
+            if( aliasTable[ i ].name == NULL )
+            {
+                continue;
+            }
+            UTL_QueueOutput( "alias %s=", aliasTable[ i ].name );
+            for( int t = 0; t < aliasTable[ i ].numTokens; t++ )
+            {
+                UTL_QueueOutput( ( t == 0 ) ? "%s" : " %s",
+                                 aliasTable[ i ].tokens[ t ] );
+            }
+            UTL_QueueOutput( "\n" );
+        }
+        UTL_FlushOutput();
+        return( EXIT_SUCCESS );
+    }
+
+    /*----------------------------------------------------------------
+     * Define: the first argument carries NAME=first-word (the shell
+     * has no quoting, so the rest of the replacement arrives as the
+     * remaining arguments). Split in place around the '='.
+     *--------------------------------------------------------------*/
+    lp_eq = strchr( command->args[ 1 ], '=' );
+    if( lp_eq == NULL || lp_eq == command->args[ 1 ] || lp_eq[ 1 ] == '\0' )
+    {
+        UTL_FlushedPrintOut( "alias: expected NAME=word [word ...]\n" );
+        return( EXIT_FAILURE );
+    }
+    lp_name = command->args[ 1 ];
+    *lp_eq  = '\0';
+
+    /* Count the replacement tokens: the split word plus the rest. */
+    numTokens = 1;
+    while( command->args[ 1 + numTokens ] != NULL )
+    {
+        numTokens += 1;
+    }
+
+    command->args[ 1 ] = lp_eq + 1;
+    AliasSet( lp_name, &command->args[ 1 ], numTokens );
+
+    return( EXIT_SUCCESS );
+
+} /* end - MyAlias() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      MyChangeDir
+ *
+ * DESCRIPTION
+ *      This function performs the built-in 'cd' command. If no argument is
+ *      supplied, this will change the current directory to the vlaue of the
+ *      HOME environment variable. Otherwise, it will attempt to change the
+ *      directory to the supplied argument.
+ *  
+ ****************************************************************************/
+
+static int MyChangeDir
+    (
+    cmdStruct          *command         /* The command containing the
+                                           necessary info for CD            */ 
+    )
+{
+    /* No directory given, use HOME environment variable instead. */
+    if( command-> args[ 1 ] == NULL )
+    {
+        if( chdir( EnvLookup( HOME_ENV ) ) == -1 )
+        {
+            fprintf( stderr, "Failed to change directory to HOME environment variable.\n" );
+            return( EXIT_FAILURE );
+        }
+    }
+    /* Attempt to CD to directory provided. */
+    else if( chdir( command->args[ 1 ] ) == -1 )
+    {
+        UTL_FlushedPrintOut( "Invalid path %s\n", command->args[ 1 ] );
+        return( EXIT_FAILURE );
+    }
+
+    /*----------------------------------------------------------------
+     * The redirection fd cache keys entries by the path as written,
+     * so relative-path targets now point at the wrong directory.
+     * Drop them all rather than serve a stale fd.
+     *--------------------------------------------------------------*/
+    UTL_RedirCacheReset();
+
+    return( EXIT_SUCCESS );
+
+} /* end - MyChangeDir() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      MyExit
+ *
+ * DESCRIPTION
+ *      This function performs the built-in 'exit' command. It will free all
+ *      heap-allocated memory for the current command, terminate all open
+ *      child processes, and then exit.
+ *  
+ ****************************************************************************/
+
+static int MyExit
+    (
+    cmdStruct          *command         /* The command containing exit      */ 
+    )
+{
+    /* Free all args in the command struct. */
+    FreeArgs( command );
+
+    /* Emit any still-queued notices before the blocking waits below. */
+    UTL_FlushOutput();
+
+    /* Trim the history log's preallocated tail back to its content. */
+    if( histMap != NULL )
+    {
+        msync( histMap, histFileLen, MS_ASYNC );
+        munmap( histMap, histMapSize );
+        if( ftruncate( histFd, histFileLen ) == -1 )
+        {
+            ;
+        }
+        close( histFd );
+    }
+
+    /* Terminate all ongoing child processes. */
+    for( size_t i = 0; i < jobTableSize; i++ )
+    {
+        if( jobTable[ i ].pid != 0 )
+        {
+            /* Send signal to terminate child. */
+            kill( jobTable[ i ].pid, SIGTERM );
+            /* Wait for child to terminate. */
+            waitpid( jobTable[ i ].pid, &childStatus, 0 );
+        }
+    }
+
+    exit( EXIT_SUCCESS );
+
+} /* end - MyExit() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      MyExport
+ *
+ * DESCRIPTION
+ *      This function performs the built-in 'export' command. Each argument
+ *      of the form NAME=value is installed into the environment, where
+ *      child processes inherit it and variable expansion picks it up. This
+ *      is the only path through which the environment changes under a
+ *      running shell, so it is also the only place the environment lookup
+ *      cache is invalidated.
+ *
+ ****************************************************************************/
+
+static int MyExport
+    (
+    cmdStruct          *command         /* The command containing export    */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    char       *lp_eq;
+    int         status;
+
+    /******************************
+    *  INITIALIZE VARIABLES
+    ******************************/
+    status      = EXIT_SUCCESS;
+
+    for( int i = 1; command->args[ i ] != NULL; i++ )
+    {
+        /*-----------------------------------------------
+         * Split NAME=value in place around the first
+         * '=', restoring the byte so the token reads
+         * back intact in debug output.
+         *---------------------------------------------*/
+        lp_eq = strchr( command->args[ i ], '=' );
+        if( lp_eq == NULL || lp_eq == command->args[ i ] )
+        {
+            UTL_FlushedPrintOut( "export: expected NAME=value, got %s\n",
+                                 command->args[ i ] );
+            status = EXIT_FAILURE;
+            continue;
+        }
+        *lp_eq = '\0';
+        setenv( command->args[ i ], lp_eq + 1, 1 );
+        *lp_eq = '=';
+    }
+
+    /* Cached getenv results may now be stale. */
+    EnvCacheReset();
+
+    return( status );
+
+} /* end - MyExport() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      MyBg
+ *
+ * DESCRIPTION
+ *      This function performs the built-in 'bg' command. It sends SIGCONT
+ *      to the job with the given pid so a stopped background job resumes
+ *      running, without forking an external process to do it.
+ *
+ ****************************************************************************/
+
+static int MyBg
+    (
+    cmdStruct          *command         /* The command containing bg        */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    pid_t       pid;
+
+    /* Validate the pid argument against the job table. */
+    pid = ( command->args[ 1 ] != NULL ) ? (pid_t)atoi( command->args[ 1 ] ) : 0;
+    if( pid <= 0 || JobHashFind( pid ) == -1 )
+    {
+        UTL_FlushedPrintOut( "bg: no such job\n" );
+        return( EXIT_FAILURE );
+    }
+
+    /* Resume the job in the background. */
+    kill( pid, SIGCONT );
+    UTL_FlushedPrintOut( "continued pid %d\n", pid );
+
+    return( EXIT_SUCCESS );
+
+} /* end - MyBg() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      MyFg
+ *
+ * DESCRIPTION
+ *      This function performs the built-in 'fg' command. It resumes the
+ *      job with the given pid and waits for it in the foreground, updating
+ *      the last-status bookkeeping the same way a foreground launch does.
+ *
+ ****************************************************************************/
+
+static int MyFg
+    (
+    cmdStruct          *command         /* The command containing fg        */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    pid_t           pid;
+    struct rusage   usage;
+
+    /* Validate the pid argument against the job table. */
+    pid = ( command->args[ 1 ] != NULL ) ? (pid_t)atoi( command->args[ 1 ] ) : 0;
+    if( pid <= 0 || JobHashFind( pid ) == -1 )
+    {
+        UTL_FlushedPrintOut( "fg: no such job\n" );
+        return( EXIT_FAILURE );
+    }
+
+    /* Resume the job and wait for it like a foreground command. */
+    kill( pid, SIGCONT );
+
+    foregroundChild = TRUE;
+    /* Safe point: about to block, so emit any queued notices now. */
+    UTL_FlushOutput();
+    wait4( pid, &childStatus, 0, &usage );
+    JobRecordAdd( pid, childStatus, &usage );
+    RemoveChildPid( pid );
+    foregroundChild = FALSE;
+
+    /* If the job was terminated by a signal, display the signal. */
+    if( WIFSIGNALED( childStatus ) )
+    {
+        UTL_FlushedPrintOut( "terminated by signal %d\n", WTERMSIG( childStatus ) );
+    }
+    /* If the job terminated normally with a non-0 status, get that status. */
+    else if( childStatus != 0 )
+    {
+        childStatus = WIFEXITED( childStatus );
+    }
+
+    return( EXIT_SUCCESS );
+
+} /* end - MyFg() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      MyJobs
+ *
+ * DESCRIPTION
+ *      This function performs the built-in 'jobs' command. It lists every
+ *      running job straight out of the job table - pid, elapsed wall time,
+ *      and cached command name - so listing hundreds of jobs is a memory
+ *      walk with no forks and no procfs reads.
+ *
+ ****************************************************************************/
+
+static int MyJobs
+    (
+    cmdStruct          *command         /* The command containing jobs      */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    long            elapsed;
+    struct timespec now;
+
+    /* Appease compiler warning. */
+    if( command )
+    {
+        ;
+    }
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+
+    /* Walk the job table and report every live slot. */
+    for( size_t i = 0; i < jobTableSize; i++ )
+    {
+        if( jobTable[ i ].pid != 0 )
+        {
+            elapsed = now.tv_sec - jobTable[ i ].start.tv_sec;
+            UTL_FlushedPrintOut( "%8d  %6lds  %s\n",
+                jobTable[ i ].pid, elapsed, jobTable[ i ].name );
+        }
+    }
+
+    return( EXIT_SUCCESS );
+
+} /* end - MyJobs() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      MyStats
+ *
+ * DESCRIPTION
+ *      This function performs the built-in 'stats' command. It prints the
+ *      per-stage latency histograms accumulated around the main loop's
+ *      four stages and ExternalCommand's launch and foreground-reap
+ *      intervals: per stage, the sample count, average, and approximate
+ *      p50/p99 read off the log2 bucket boundaries.
+ *
+ ****************************************************************************/
+
+static int MyStats
+    (
+    cmdStruct          *command         /* The command containing stats     */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    unsigned long       cumulative;
+    statHistogram      *lp_hist;
+    unsigned long long  p50Ns;
+    unsigned long long  p99Ns;
+
+    /* Appease compiler warning. */
+    if( command )
+    {
+        ;
+    }
+
+    UTL_FlushedPrintOut( "%-14s %10s %12s %12s %12s\n",
+                         "stage", "count", "avg us", "~p50 us", "~p99 us" );
+
+    for( int stage = 0; stage < STAT_NUM_STAGES; stage++ )
+    {
+        lp_hist = &statHistograms[ stage ];
+        if( lp_hist->count == 0 )
+        {
+            continue;
+        }
+
+        /*---------------------------------------------------------------
+         * Walk the buckets cumulatively to find the percentile bucket;
+         * report its upper boundary (2^bucket nanoseconds).
+         *-------------------------------------------------------------*/
+        cumulative  = 0;
+        p50Ns       = 0;
+        p99Ns       = 0;
+        for( int b = 0; b < STAT_NUM_BUCKETS; b++ )
+        {
+            cumulative += lp_hist->buckets[ b ];
+            if( p50Ns == 0 && cumulative * 2 >= lp_hist->count )
+            {
+                p50Ns = 1ull << b;
+            }
+            if( p99Ns == 0 && cumulative * 100 >= lp_hist->count * 99 )
+            {
+                p99Ns = 1ull << b;
+            }
+        }
+
+        UTL_FlushedPrintOut( "%-14s %10lu %12.1f %12.1f %12.1f\n",
+            statStageNames[ stage ],
+            lp_hist->count,
+            ( lp_hist->totalNs / (double)lp_hist->count ) / 1000.0,
+            p50Ns / 1000.0,
+            p99Ns / 1000.0 );
+    }
+
+    return( EXIT_SUCCESS );
+
+} /* end - MyStats() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      MyStatus
+ *
+ * DESCRIPTION
+ *      This function performs the built-in 'status' command by printing out
+ *      the exit status of the last terminated child process. With '-v' it
+ *      also dumps the rolling ring of recent job records - wall time, CPU
+ *      times, and peak RSS captured by wait4 at reap time - oldest first,
+ *      so resource-hog jobs stand out without wrapping commands in
+ *      /usr/bin/time.
+ *
+ ****************************************************************************/
+
+static int MyStatus
+    (
+    cmdStruct          *command         /* The command containing status    */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    size_t          idx;
+    jobRecord      *lp_rec;
+
+    /* Inform user of last non-built-in command's exit status. */
+    UTL_FlushedPrintOut( "exit status %d\n", childStatus );
+
+    /* Plain status stops here; -v adds the recent-job table. */
+    if( command->args[ 1 ] == NULL || strcmp( command->args[ 1 ], "-v" ) != 0 )
+    {
+        return( EXIT_SUCCESS );
+    }
+
+    UTL_FlushedPrintOut( "%8s %10s %10s %10s %10s  %s\n",
+        "pid", "wall ms", "user ms", "sys ms", "maxrss kb", "command" );
+
+    /* Walk the ring oldest record first. */
+    for( size_t i = 0; i < jobRingCount; i++ )
+    {
+        idx    = ( jobRingNext + JOB_RING_SIZE - jobRingCount + i ) % JOB_RING_SIZE;
+        lp_rec = &jobRing[ idx ];
+
+        UTL_FlushedPrintOut( "%8d %10.1f %10.1f %10.1f %10ld  %s\n",
+            lp_rec->pid,
+            lp_rec->wallNs / 1000000.0,
+            lp_rec->userTime.tv_sec * 1000.0 + lp_rec->userTime.tv_usec / 1000.0,
+            lp_rec->sysTime.tv_sec  * 1000.0 + lp_rec->sysTime.tv_usec  / 1000.0,
+            lp_rec->maxRss,
+            lp_rec->name );
+    }
+
+    return( EXIT_SUCCESS );
+
+} /* end - MyStatus() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      ParseCommand
+ *
+ * DESCRIPTION
+ *      This function takes user input and parses them into its constituent
+ *      parts, filling up the command struct as appropriate. The string is
+ *      tokenized on spaces in place; tokens containing '$$' are expanded
+ *      into arena memory, while all others are borrowed directly from the
+ *      input buffer with no copy. The resulting string is then checked for
+ *      its type. The command and most arguments are stored in the command
+ *      struct's arg array except for the following:
+ *          - Input and output symbols
+ *          - The argument immediately following an input/output symbol
+ *          - The here-string symbol '<<<' and its payload, which lands
+ *            in a sealed memfd instead of the args array
+ *          - Background indicator '&' if it is the last argument
+ *  
+ ****************************************************************************/
+
+static int ParseCommand
+    (
+    char               *buf,            /* The buffer after user input rec'd*/ 
+    cmdStruct          *command         /* The command struct to fill up    */ 
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    char       *lp_arg;
+    int         argCount;
+    bool        hereFlag;
+    bool        inputFlag;
+    bool        outputFlag;
+    char       *lp_tempArg;
+    size_t      pieceLen;
+    char        subst[ SUBST_MAX_LEN ];
+    size_t      substLen;
+
+    /******************************
+    *  INITIALIZE VARIABLES
+    ******************************/
+    lp_arg                      = NULL;
+    lp_tempArg                  = NULL;
+    argCount                    = 0;
+    hereFlag                    = FALSE;
+    inputFlag                   = FALSE;
+    outputFlag                  = FALSE;
+    command->isBackground       = FALSE;
+    command->isRedirectInput    = FALSE;
+    command->isRedirectOutput   = FALSE;
+    command->isAppendOutput     = FALSE;
+    command->isConcurrent       = FALSE;
+    command->listSep            = LIST_SEP_NONE;
+    command->numStages          = 1;
+    command->stageStart[ 0 ]    = 0;
+
+    /* Drop any here-string left over from the previous list member. */
+    if( command->hereFd != -1 )
+    {
+        close( command->hereFd );
+        command->hereFd = -1;
+    }
+
+    /*----------------------------------------------------------------
+     * Fill the command's args array. The bound is on argCount, not
+     * just iterations: glob and substitution expansion can advance
+     * argCount by many entries per token, so stop consuming tokens
+     * as soon as only the terminating NULL slot remains.
+     *--------------------------------------------------------------*/
+    for( int i = 0; i < MAX_ARGS && argCount < MAX_ARGS - 1; i++ )
+    {
+        /* Tokenize input, ignoring ending newline. */
+        lp_arg = TokenNext( buf );
+        /* Reached end up input tokens. */
+        if( lp_arg == NULL )
+        {
+            break;
+        }
+
+        /* Set buf to NULL so subsequent calls continue the same line. */
+        buf = NULL;
+
+        /*-----------------------------------------------
+         * Expand variable references. Tokens without a
+         * '$' - the overwhelmingly common case - are
+         * borrowed in place from the input buffer, which
+         * the tokenizer has already NUL-terminated, so
+         * no allocation or copy happens for them at all.
+         *---------------------------------------------*/
+        if( lp_arg[ UTL_ScanSpan( lp_arg, '$', '$' ) ] != '\0' )
+        {
+            lp_tempArg = ExpandVars( lp_arg );
+        }
+        else
+        {
+            lp_tempArg = lp_arg;
+        }
+
+        /*----------------------------------------------- 
+         * Build command struct based on argument value.
+         *---------------------------------------------*/
+
+        /*-----------------------------------------------
+         * If input indicator was last argument seen,
+         * use next argument as input redirection file.
+         *---------------------------------------------*/
+        if( inputFlag == TRUE )
+        {
+            command->input = lp_tempArg;
+            inputFlag = FALSE;
+        }
+        /*-----------------------------------------------
+         * If output indicator was last argument seen,
+         * use next argument as output redirection file.
+         *---------------------------------------------*/
+        else if( outputFlag == TRUE )
+        {
+            command->output = lp_tempArg;
+            outputFlag = FALSE;
+        }
+        /*-----------------------------------------------
+         * If here-string indicator was last argument
+         * seen, this argument is the payload; park it
+         * in a sealed memfd ready to become stdin.
+         *---------------------------------------------*/
+        else if( hereFlag == TRUE )
+        {
+            command->hereFd = HereStringFd( lp_tempArg );
+            hereFlag = FALSE;
+        }
+        /* Current argument is here-string indicator, set flag. */
+        else if( strncmp( lp_tempArg, HERE_OP, 4 ) == 0 )
+        {
+            hereFlag = TRUE;
+        }
+        /* Current argument is input indicator, set flag. */
+        else if( strncmp( lp_tempArg, INPUT, 2 ) == 0 )
+        {
+            command->isRedirectInput = TRUE;
+            inputFlag = TRUE;
+        }
+        /* Current argument is append indicator, set flags. */
+        else if( strncmp( lp_tempArg, APPEND, 3 ) == 0 )
+        {
+            command->isRedirectOutput = TRUE;
+            command->isAppendOutput   = TRUE;
+            outputFlag = TRUE;
+        }
+        /* Current argument is output indicator, set flag. */
+        else if( strncmp( lp_tempArg, OUTPUT, 2 ) == 0 )
+        {
+            command->isRedirectOutput = TRUE;
+            outputFlag = TRUE;
+        }
+        /*-----------------------------------------------
+         * Current argument is a list separator. Stop
+         * parsing here; RunCommandList resumes the
+         * tokenizer on the rest of the line for the
+         * next member.
+         *---------------------------------------------*/
+        else if( strncmp( lp_tempArg, AND_OP, 3 ) == 0 )
+        {
+            command->listSep = LIST_SEP_AND;
+            break;
+        }
+        else if( strncmp( lp_tempArg, SEQ_OP, 2 ) == 0 )
+        {
+            command->listSep = LIST_SEP_SEQ;
+            break;
+        }
+        /*-----------------------------------------------
+         * Current argument is a pipe operator. End the
+         * current stage with a NULL separator and record
+         * where the next stage's arguments begin.
+         *---------------------------------------------*/
+        else if( strncmp( lp_tempArg, PIPE_OP, 2 ) == 0 )
+        {
+            /*-------------------------------------------
+             * A stage past the cap cannot be recorded;
+             * refuse the whole line rather than silently
+             * merging its argv into the current stage
+             * and running a different command than the
+             * one written.
+             *-----------------------------------------*/
+            if( command->numStages == MAX_STAGES )
+            {
+                fprintf( stderr, "Invalid pipeline: too many stages (max %d)\n", MAX_STAGES );
+                command->args[ 0 ]  = NULL;
+                command->numStages  = 1;
+                command->listSep    = LIST_SEP_NONE;
+                break;
+            }
+
+            UTL_DebugPrint( "Stage break at argument %d\n", argCount );
+            command->args[ argCount ] = NULL;
+            argCount++;
+            command->stageStart[ command->numStages ] = argCount;
+            command->numStages++;
+        }
+        /*-----------------------------------------------
+         * Command substitution. The body may span
+         * several tokens; stitch them back together up
+         * to the closing paren, then capture the inner
+         * command's stdout into the args array.
+         *---------------------------------------------*/
+        else if( strncmp( lp_tempArg, SUBST_OPEN, 2 ) == 0 )
+        {
+            substLen = strlen( lp_tempArg + 2 );
+            if( substLen < sizeof( subst ) )
+            {
+                memcpy( subst, lp_tempArg + 2, substLen + 1 );
+            }
+            else
+            {
+                subst[ 0 ] = '\0';
+                substLen   = 0;
+            }
+
+            /* Pull tokens until one closes the substitution. */
+            while( ( substLen == 0 || subst[ substLen - 1 ] != SUBST_CLOSE )
+                && ( lp_arg = TokenNext( NULL ) ) != NULL )
+            {
+                pieceLen = strlen( lp_arg );
+                if( substLen + pieceLen + 2 >= sizeof( subst ) )
+                {
+                    break;
+                }
+                subst[ substLen ] = ' ';
+                memcpy( subst + substLen + 1, lp_arg, pieceLen + 1 );
+                substLen += pieceLen + 1;
+            }
+
+            /* Drop the closing paren before running the body. */
+            if( substLen > 0 && subst[ substLen - 1 ] == SUBST_CLOSE )
+            {
+                subst[ substLen - 1 ] = '\0';
+            }
+
+            argCount = CommandSubst( subst, command, argCount );
+        }
+        /* Glob patterns expand into however many entries they match. */
+        else if( strpbrk( lp_tempArg, "*?" ) != NULL )
+        {
+            UTL_DebugPrint( "Glob pattern %s\n", lp_tempArg );
+            argCount = GlobExpand( lp_tempArg, command, argCount );
+        }
+        /* All other arguments are stored in argument array. */
+        else
+        {
+            UTL_DebugPrint( "Argument %d is %s\n", i, lp_tempArg );
+            command->args[ argCount ] = lp_tempArg;
+            argCount++;
+        }
+
+    }
+
+    /*----------------------------------------------------------------
+     * Background commands only occur when & is the last character and
+     * a SIGTSTP signal has not set the shell to ignore background
+     * command requests.
+     *--------------------------------------------------------------*/
+    if( argCount > 0 && command->args[ argCount - 1] && ( strncmp( command->args[ argCount - 1 ], BACKGROUND, 2 ) == 0 ) )
+    {
+        UTL_DebugPrint( "Removing background arg %s\n", command->args[ argCount - 1 ] );
+        if( ignoreBackground == FALSE )
+        {
+            command->isBackground = TRUE;
+        }
+        else
+        {
+            command->isBackground = FALSE;
+        }
+        command->args[ argCount - 1 ] = NULL;
+    }
+
+    /* Remember how many slots were used so reset can stay lazy. */
+    command->argCount = argCount;
+
+    /* Splice in any alias for the command name; dispatch sees it resolved. */
+    AliasExpand( command );
+
+    UTL_Trace( UTL_TRACE_PARSE, 0, command->argCount );
+
+    return( EXIT_SUCCESS );
+
+} /* end - ParseCommand() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      PathCacheReset
+ *
+ * DESCRIPTION
+ *      This function empties the PATH resolution cache, freeing every stored
+ *      name and path along with the remembered PATH string. Called whenever
+ *      the PATH environment variable is observed to have changed.
+ *
+ ****************************************************************************/
+
+static int PathCacheReset(void)
+{
+    /* Free every occupied slot in the cache. */
+    for( size_t i = 0; i < PATH_CACHE_SIZE; i++ )
+    {
+        if( pathCache[ i ].name != NULL )
+        {
+            free( pathCache[ i ].name );
+            free( pathCache[ i ].path );
+            pathCache[ i ].name = NULL;
+            pathCache[ i ].path = NULL;
+        }
+    }
+
+    /* Forget the PATH string the cache was built against. */
+    free( pathCacheEnv );
+    pathCacheEnv    = NULL;
+    pathCacheCount  = 0;
+
+    return( EXIT_SUCCESS );
+
+} /* end - PathCacheReset() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      PathIndexCollect
+ *
+ * DESCRIPTION
+ *      This function builds the completion index: every entry name from
+ *      every PATH directory, collected into one array, sorted, and with
+ *      names shadowed by an earlier PATH entry squeezed out. Lookups are
+ *      then a binary search over a flat sorted array. Any previous index
+ *      is freed first, so this doubles as the rebuild path.
+ *
+ * NOTES
+ *      Runs on the background build thread at startup and on the main
+ *      thread for rebuilds; the index deliberately uses plain malloc, not
+ *      the arena, since the arena is neither thread-safe nor long-lived.
+ *
+ ****************************************************************************/
+
+static int PathIndexCollect(void)
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    size_t          cap;
+    char            dirPath[ PATH_MAX_LEN ];
+    size_t          dirLen;
+    size_t          keep;
+    const char     *lp_dir;
+    DIR            *lp_dirHandle;
+    const char     *lp_end;
+    struct dirent  *lp_ent;
+    char           *lp_pathEnv;
+
+    /******************************
+    *  INITIALIZE VARIABLES
+    ******************************/
+    cap = 0;
+
+    lp_pathEnv = getenv( PATH_ENV );
+    if( lp_pathEnv == NULL )
+    {
+        return( EXIT_FAILURE );
+    }
+
+    /* Drop the previous index before rebuilding. */
+    for( size_t i = 0; i < pathIndexCount; i++ )
+    {
+        free( pathIndex[ i ] );
+    }
+    free( pathIndex );
+    pathIndex      = NULL;
+    pathIndexCount = 0;
+    free( pathIndexEnv );
+    pathIndexEnv   = strdup( lp_pathEnv );
+
+    /* Collect every entry name from every PATH directory. */
+    lp_dir = lp_pathEnv;
+    while( *lp_dir != '\0' )
+    {
+        lp_end = strchr( lp_dir, ':' );
+        dirLen = ( lp_end != NULL ) ? (size_t)( lp_end - lp_dir ) : strlen( lp_dir );
+
+        if( dirLen > 0 && dirLen < sizeof( dirPath ) )
+        {
+            memcpy( dirPath, lp_dir, dirLen );
+            dirPath[ dirLen ] = '\0';
+
+            lp_dirHandle = opendir( dirPath );
+            if( lp_dirHandle != NULL )
+            {
+                while( ( lp_ent = readdir( lp_dirHandle ) ) != NULL )
+                {
+                    if( lp_ent->d_name[ 0 ] == '.' )
+                    {
+                        continue;
+                    }
+                    if( pathIndexCount >= cap )
+                    {
+                        cap       = ( cap == 0 ) ? 1024 : cap * 2;
+                        pathIndex = realloc( pathIndex, cap * sizeof( char * ) );
+                        if( pathIndex == NULL )
+                        {
+                            fprintf( stderr, "Failed to allocate PATH index\n" );
+                            exit( EXIT_FAILURE );
+                        }
+                    }
+                    pathIndex[ pathIndexCount ] = strdup( lp_ent->d_name );
+                    pathIndexCount += 1;
+                }
+                closedir( lp_dirHandle );
+            }
+        }
+
+        /* Advance to the next PATH component. */
+        lp_dir += dirLen;
+        if( *lp_dir == ':' )
+        {
+            lp_dir += 1;
+        }
+    }
+
+    /* Sort once so every lookup is a binary search. */
+    qsort( pathIndex, pathIndexCount, sizeof( char * ), GlobCompareName );
+
+    /* Squeeze out names shadowed by an earlier PATH entry. */
+    keep = 0;
+    for( size_t i = 0; i < pathIndexCount; i++ )
+    {
+        if( keep > 0 && strcmp( pathIndex[ keep - 1 ], pathIndex[ i ] ) == 0 )
+        {
+            free( pathIndex[ i ] );
+            continue;
+        }
+        pathIndex[ keep ] = pathIndex[ i ];
+        keep += 1;
+    }
+    pathIndexCount = keep;
+
+    return( EXIT_SUCCESS );
+
+} /* end - PathIndexCollect() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      PathIndexEnsure
+ *
+ * DESCRIPTION
+ *      This function makes the completion index safe to read on the main
+ *      thread. The startup build thread is joined the first time through;
+ *      after that the index is rebuilt in place whenever PATH no longer
+ *      matches the value it was built against — the same trigger the PATH
+ *      resolution cache uses, and ResolvePath marks the index stale when
+ *      it observes the change, so the two invalidate together without
+ *      duplicate directory walks.
+ *
+ ****************************************************************************/
+
+static int PathIndexEnsure(void)
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    char       *lp_pathEnv;
+
+    /* Sync with the startup build thread exactly once. */
+    if( pathIndexStarted == TRUE && pathIndexJoined == FALSE )
+    {
+        pthread_join( pathIndexThread, NULL );
+        pathIndexJoined = TRUE;
+    }
+
+    lp_pathEnv = getenv( PATH_ENV );
+    if( lp_pathEnv == NULL )
+    {
+        return( EXIT_FAILURE );
+    }
+
+    /* Rebuild when PATH has changed out from under the index. */
+    if( pathIndexStale == TRUE || pathIndexEnv == NULL
+     || strcmp( pathIndexEnv, lp_pathEnv ) != 0 )
+    {
+        PathIndexCollect();
+        pathIndexStale = FALSE;
+    }
+
+    return( ( pathIndex != NULL ) ? EXIT_SUCCESS : EXIT_FAILURE );
+
+} /* end - PathIndexEnsure() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      PathIndexLower
+ *
+ * DESCRIPTION
+ *      This function returns the index of the first entry in the sorted
+ *      PATH index that is not less than the given prefix. Entries sharing
+ *      the prefix form a contiguous run starting there.
+ *
+ ****************************************************************************/
+
+static size_t PathIndexLower
+    (
+    const char         *prefix          /* The prefix to locate             */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    size_t      hi;
+    size_t      lo;
+    size_t      mid;
+
+    /******************************
+    *  INITIALIZE VARIABLES
+    ******************************/
+    lo = 0;
+    hi = pathIndexCount;
+
+    while( lo < hi )
+    {
+        mid = lo + ( hi - lo ) / 2;
+        if( strcmp( pathIndex[ mid ], prefix ) < 0 )
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    return( lo );
+
+} /* end - PathIndexLower() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      PathIndexThreadFn
+ *
+ * DESCRIPTION
+ *      Thread entry for the startup index build. Runs the collection off
+ *      the critical path so the first prompt appears immediately; the main
+ *      thread does not touch the index until PathIndexEnsure has joined
+ *      this thread.
+ *
+ ****************************************************************************/
+
+static void *PathIndexThreadFn
+    (
+    void               *arg             /* Unused thread argument           */
+    )
+{
+    /* Appease compiler warning. */
+    if( arg )
+    {
+        ;
+    }
+
+    PathIndexCollect();
+
+    return( NULL );
+
+} /* end - PathIndexThreadFn() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      PipelineCommand
+ *
+ * DESCRIPTION
+ *      This function runs a multi-stage pipeline by forking every stage
+ *      concurrently with pipe(2) fds connecting adjacent stages, so data
+ *      moves kernel-side between the children and never touches the
+ *      filesystem. Input redirection applies to the first stage, output
+ *      redirection to the last, and background/dev-null plumbing matches
+ *      the single-command engines.
+ *
+ ****************************************************************************/
+
+static int PipelineCommand
+    (
+    cmdStruct          *command         /* The pipeline to run              */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    int         fd;
+    bool        isLast;
+    char      **lp_stageArgs;
+    char       *lp_resolved;
+    pid_t           pid;
+    int             pipeFds[ 2 ];
+    pid_t           pids[ MAX_STAGES ];
+    int             prevRead;
+    struct rusage   usage;
+
+    /******************************
+    *  INITIALIZE VARIABLES
+    ******************************/
+    prevRead    = -1;
+
+    /* Refuse pipelines with an empty stage (e.g. "a | | b"). */
+    for( int s = 0; s < command->numStages; s++ )
+    {
+        if( command->args[ command->stageStart[ s ] ] == NULL )
+        {
+            fprintf( stderr, "Invalid pipeline: empty stage\n" );
+            return( EXIT_FAILURE );
+        }
+    }
+
+    /* Fork every stage concurrently, plumbing pipes between neighbors. */
+    for( int s = 0; s < command->numStages; s++ )
+    {
+        isLast       = ( s == command->numStages - 1 );
+        lp_stageArgs = &command->args[ command->stageStart[ s ] ];
+        /* Resolve in the parent so the cache fill is shared. */
+        lp_resolved  = ResolvePath( lp_stageArgs[ 0 ] );
+
+        /* Interior stage: create the pipe feeding the next stage. */
+        if( !isLast && pipe( pipeFds ) == -1 )
+        {
+            fprintf( stderr, "Failed to create pipe\n" );
+            return( EXIT_FAILURE );
+        }
+
+        pid = fork();
+
+        /* Could not create child process */
+        if( pid == -1 )
+        {
+            fprintf( stderr, "Failed to fork child process\n" );
+            return( EXIT_FAILURE );
+        }
+
+        /* Child process drops in here */
+        if( pid == 0 )
+        {
+            /* Reset SIGCHLD to default handler */
+            struct sigaction SIGCHLD_action = {0};
+            SIGCHLD_action.sa_handler = SIG_DFL;
+            sigaction( SIGCHLD, &SIGCHLD_action, NULL );
+
+            /* Ignore SIGTSTP signals */
+            struct sigaction SIGTSTP_action = {0};
+            SIGTSTP_action.sa_handler = SIG_IGN;
+            sigaction( SIGTSTP, &SIGTSTP_action, NULL );
+
+            /* Stop ignoring SIGINT for foreground pipelines */
+            if( command->isBackground == FALSE )
+            {
+                struct sigaction SIGINT_action = {0};
+                SIGINT_action.sa_handler = SIG_DFL;
+                sigaction( SIGINT, &SIGINT_action, NULL );
+            }
+
+            /* Stdin: previous stage's pipe, here-string, redirect, or dev/null. */
+            if( prevRead != -1 )
+            {
+                dup2( prevRead, STDIN_FILENO );
+                close( prevRead );
+            }
+            else if( command->hereFd != -1 )
+            {
+                lseek( command->hereFd, 0, SEEK_SET );
+                dup2( command->hereFd, STDIN_FILENO );
+            }
+            else if( command->isRedirectInput == TRUE )
+            {
+                fd = UTL_RedirOpen( command->input, O_RDONLY );
+                if( fd == -1 )
+                {
+                    fprintf( stderr, "cannot open %s for input\n", command->input );
+                    exit( EXIT_FAILURE );
+                }
+                dup2( fd, STDIN_FILENO );
+            }
+            else if( command->isBackground == TRUE )
+            {
+                fd = OPEN_FILE_READ( DEV_NULL );
+                dup2( fd, STDIN_FILENO );
+            }
+
+            /* Stdout: next stage's pipe, redirect, or dev/null. */
+            if( !isLast )
+            {
+                close( pipeFds[ 0 ] );
+                dup2( pipeFds[ 1 ], STDOUT_FILENO );
+                close( pipeFds[ 1 ] );
+            }
+            else if( command->isRedirectOutput == TRUE )
+            {
+                fd = UTL_RedirOpen( command->output,
+                    O_WRONLY | O_CREAT | ( ( command->isAppendOutput == TRUE ) ? O_APPEND : O_TRUNC ) );
+                if( fd == -1 )
+                {
+                    fprintf( stderr, "cannot open %s for output\n", command->output );
+                    exit( EXIT_FAILURE );
+                }
+                dup2( fd, STDOUT_FILENO );
+            }
+            else if( command->isBackground == TRUE )
+            {
+                fd = OPEN_FILE_WRITE( DEV_NULL );
+                dup2( fd, STDOUT_FILENO );
+            }
+
+            /* Exec the stage; see ForkCommand for the fallback logic. */
+            if( lp_resolved != NULL )
+            {
+                execv( lp_resolved, lp_stageArgs );
+            }
+            if( execvp( lp_stageArgs[ 0 ], lp_stageArgs ) == -1 )
+            {
+                UTL_FlushedPrintOut( "%s: no such file or directory\n", lp_stageArgs[ 0 ] );
+            }
+
+            exit( EXIT_FAILURE );
+        }
+
+        /* Parent: hand the pipe ends over to the children. */
+        if( prevRead != -1 )
+        {
+            close( prevRead );
+        }
+        if( !isLast )
+        {
+            close( pipeFds[ 1 ] );
+            prevRead = pipeFds[ 0 ];
+        }
+
+        pids[ s ] = pid;
+        AddChildPid( pid, lp_stageArgs[ 0 ] );
+    }
+
+    /* Concurrent list member: the scheduler joins the last stage later. */
+    if( command->isConcurrent == TRUE )
+    {
+        schedLastPid = pids[ command->numStages - 1 ];
+        return( EXIT_SUCCESS );
+    }
+
+    /* Wait and block until every foreground stage completes. */
+    if( command->isBackground == FALSE )
+    {
+        foregroundChild = TRUE;
+        /* Safe point: about to block, so emit any queued notices now. */
+        UTL_FlushOutput();
+        for( int s = 0; s < command->numStages; s++ )
+        {
+            wait4( pids[ s ], &childStatus, 0, &usage );
+            JobRecordAdd( pids[ s ], childStatus, &usage );
+            RemoveChildPid( pids[ s ] );
+        }
+        foregroundChild = FALSE;
+
+        /* If the last stage was terminated by a signal, display it. */
+        if( WIFSIGNALED( childStatus ) )
+        {
+            UTL_FlushedPrintOut( "terminated by signal %d\n", WTERMSIG( childStatus ) );
+        }
+        /* If the last stage exited with a non-0 status, get that status. */
+        else if( childStatus != 0 )
+        {
+            childStatus = WIFEXITED( childStatus );
+        }
+    }
+    /* Inform user of the background pipeline's last pid. */
+    else
+    {
+        UTL_FlushedPrintOut( "background pid is %d\n", pids[ command->numStages - 1 ] );
+    }
+
+    return( EXIT_SUCCESS );
+
+} /* end - PipelineCommand() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      PromptFlush
+ *
+ * DESCRIPTION
+ *      This function composes everything owed to the user at a prompt
+ *      boundary - queued background-completion notices, any pending
+ *      foreground-only mode-change message, and the prompt itself - into
+ *      one iovec and emits it with a single writev. The mode-change flags
+ *      set by HandleSIGTSTP are consumed here, so the handler never has to
+ *      write from signal context.
+ *
+ ****************************************************************************/
+
+static int PromptFlush
+    (
+    void
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    struct iovec    iov[ 2 ];
+    int             iovCount;
+
+    /******************************
+    *  INITIALIZE VARIABLES
+    ******************************/
+    iovCount    = 0;
+
+    /*-----------------------------------------------------------------------
+     * Pick up a mode change recorded by HandleSIGTSTP. The lengths come
+     * from sizeof on the message macros, so they cannot drift from the
+     * text.
+     *---------------------------------------------------------------------*/
+    if( backgroundIgnoreSet )
+    {
+        iov[ iovCount ].iov_base    = FG_ONLY_ENTER_MSG;
+        iov[ iovCount ].iov_len     = sizeof( FG_ONLY_ENTER_MSG ) - 1;
+        iovCount += 1;
+        backgroundIgnoreSet = FALSE;
+    }
+    else if( backgroundUnignoreSet )
+    {
+        iov[ iovCount ].iov_base    = FG_ONLY_EXIT_MSG;
+        iov[ iovCount ].iov_len     = sizeof( FG_ONLY_EXIT_MSG ) - 1;
+        iovCount += 1;
+        backgroundUnignoreSet = FALSE;
+    }
+
+    iov[ iovCount ].iov_base    = PROMPT_STR;
+    iov[ iovCount ].iov_len     = sizeof( PROMPT_STR ) - 1;
+    iovCount += 1;
+
+    return( UTL_FlushOutputV( iov, iovCount ) );
+
+} /* end - PromptFlush() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      RcChecksum
+ *
+ * DESCRIPTION
+ *      This function folds a byte range into a 64-bit FNV-1a hash. It seals
+ *      the payload of the compiled rc cache so a torn or truncated write is
+ *      detected and the cache recompiled instead of replayed.
+ *
+ ****************************************************************************/
+
+static unsigned long long RcChecksum
+    (
+    const unsigned char *data,          /* The bytes to checksum            */
+    size_t              len             /* How many bytes to fold in        */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    unsigned long long  hash;
+
+    /******************************
+    *  INITIALIZE VARIABLES
+    ******************************/
+    hash        = 14695981039346656037ull;
+
+    /* Fold each byte of the range into the hash. */
+    for( size_t i = 0; i < len; i++ )
+    {
+        hash ^= data[ i ];
+        hash *= 1099511628211ull;
+    }
+
+    return( hash );
+
+} /* end - RcChecksum() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      RcCompile
+ *
+ * DESCRIPTION
+ *      This function sources the textual rc file line by line and compiles
+ *      it into a binary image beside it as it goes. Lines whose parse is
+ *      position-independent - no variable references, globs, or
+ *      here-strings, and a single list member - are serialized
+ *      pre-tokenized, so warm startups replay them without touching the
+ *      tokenizer; everything else is stored as raw text and re-parsed at
+ *      replay. The image is stamped with the source's mtime, size, and a
+ *      payload checksum before it is written out in one shot.
+ *
+ ****************************************************************************/
+
+static int RcCompile
+    (
+    const char         *rcPath,         /* The textual rc source            */
+    const char         *cachePath,      /* Where the compiled image goes    */
+    cmdStruct          *command         /* Scratch command struct to reuse  */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    int                 argOff[ MAX_ARGS ];
+    char                blob[ RC_LINE_MAX * 2 ];
+    int                 blobLen;
+    bool                eligible;
+    int                 fd;
+    rcCacheHeader       header;
+    int                 inputOff;
+    size_t              len;
+    char               *lp_line;
+    char               *lp_next;
+    char               *lp_src;
+    int                 outputOff;
+    char                parseBuf[ RC_LINE_MAX ];
+    int                 rec[ 8 ];
+    struct stat         rcStat;
+
+    /******************************
+    *  INITIALIZE VARIABLES
+    ******************************/
+    rcImageLen  = 0;
+    rcImageCmds = 0;
+
+    /* Slurp the whole rc source; it is small by construction. */
+    fd = open( rcPath, O_RDONLY | O_CLOEXEC );
+    if( fd == -1 )
+    {
+        return( EXIT_FAILURE );
+    }
+    fstat( fd, &rcStat );
+    lp_src = malloc( rcStat.st_size + 1 );
+    if( read( fd, lp_src, rcStat.st_size ) != rcStat.st_size )
+    {
+        free( lp_src );
+        close( fd );
+        return( EXIT_FAILURE );
+    }
+    lp_src[ rcStat.st_size ] = '\0';
+    close( fd );
+
+    /* Walk the source a line at a time, NUL-terminating each in place. */
+    for( lp_line = lp_src; lp_line != NULL; lp_line = lp_next )
+    {
+        lp_next = strchr( lp_line, '\n' );
+        if( lp_next != NULL )
+        {
+            *lp_next  = '\0';
+            lp_next  += 1;
+        }
+
+        /* Skip blank and comment lines outright. */
+        while( *lp_line == ' ' || *lp_line == '\t' )
+        {
+            lp_line += 1;
+        }
+        if( *lp_line == '\0' || strncmp( lp_line, COMMENT, COMMENT_LEN ) == 0 )
+        {
+            continue;
+        }
+        len = strlen( lp_line );
+
+        /*---------------------------------------------------------------
+         * A line is eligible for pre-tokenized caching when its parse
+         * cannot depend on the environment it replays in: no variable
+         * references or globs, and short enough for the scratch buffer.
+         * Redirections, pipelines, and '&' are static and serialize fine.
+         *-------------------------------------------------------------*/
+        eligible = len < RC_LINE_MAX && strpbrk( lp_line, "$*?" ) == NULL;
+
+        if( eligible == TRUE )
+        {
+            /* Trial-parse a copy; execution below consumes the original. */
+            memcpy( parseBuf, lp_line, len + 1 );
+            ResetCommand( command );
+            ParseCommand( parseBuf, command );
+
+            /*-----------------------------------------------
+             * Multi-member lines and here-strings fall back
+             * to the raw-text record; one cmdStruct cannot
+             * carry them.
+             *---------------------------------------------*/
+            if( command->listSep != LIST_SEP_NONE
+             || command->args[ 0 ] == NULL
+             || command->hereFd != -1 )
+            {
+                eligible = FALSE;
+            }
+            else
+            {
+                /*-----------------------------------------------
+                 * Pack the token strings into a blob and the
+                 * parse result into a flat record of ints, all
+                 * offsets relative to the blob.
+                 *---------------------------------------------*/
+                blobLen = 0;
+                for( int i = 0; i < command->argCount; i++ )
+                {
+                    if( command->args[ i ] == NULL )
+                    {
+                        /* Pipeline stage separator slot. */
+                        argOff[ i ] = -1;
+                        continue;
+                    }
+                    argOff[ i ] = blobLen;
+                    blobLen += snprintf( &blob[ blobLen ],
+                                         sizeof( blob ) - blobLen,
+                                         "%s", command->args[ i ] ) + 1;
+                }
+                inputOff = -1;
+                if( command->input != NULL )
+                {
+                    inputOff = blobLen;
+                    blobLen += snprintf( &blob[ blobLen ],
+                                         sizeof( blob ) - blobLen,
+                                         "%s", command->input ) + 1;
+                }
+                outputOff = -1;
+                if( command->output != NULL )
+                {
+                    outputOff = blobLen;
+                    blobLen += snprintf( &blob[ blobLen ],
+                                         sizeof( blob ) - blobLen,
+                                         "%s", command->output ) + 1;
+                }
+
+                rec[ 0 ] = RC_REC_TOKENS;
+                rec[ 1 ] = command->argCount;
+                rec[ 2 ] = command->numStages;
+                rec[ 3 ] = ( ( command->isBackground )     ? RC_FLAG_BACKGROUND : 0 )
+                         | ( ( command->isRedirectInput )  ? RC_FLAG_REDIR_IN   : 0 )
+                         | ( ( command->isRedirectOutput ) ? RC_FLAG_REDIR_OUT  : 0 )
+                         | ( ( command->isAppendOutput )   ? RC_FLAG_APPEND     : 0 );
+                rec[ 4 ] = inputOff;
+                rec[ 5 ] = outputOff;
+                /* Keep every record int-aligned: pad the blob to 4. */
+                rec[ 6 ] = ( blobLen + 3 ) & ~3;
+
+                RcImagePut( rec, 7 * sizeof( int ) );
+                RcImagePut( command->stageStart,
+                            command->numStages * sizeof( int ) );
+                RcImagePut( argOff, command->argCount * sizeof( int ) );
+                memset( &blob[ blobLen ], 0, rec[ 6 ] - blobLen );
+                RcImagePut( blob, rec[ 6 ] );
+                rcImageCmds += 1;
+            }
+            FreeArgs( command );
+        }
+
+        if( eligible == FALSE )
+        {
+            /* Raw text record, NUL included, re-parsed at replay time. */
+            rec[ 0 ] = RC_REC_TEXT;
+            rec[ 1 ] = ( ( (int)len + 1 ) + 3 ) & ~3;
+            RcImagePut( rec, 2 * sizeof( int ) );
+            memcpy( blob, lp_line, len + 1 );
+            memset( &blob[ len + 1 ], 0, rec[ 1 ] - ( len + 1 ) );
+            RcImagePut( blob, rec[ 1 ] );
+            rcImageCmds += 1;
+        }
+
+        /* Run the line in place; the tokenizer may consume it freely. */
+        RunCommandList( lp_line, command );
+        FreeArgs( command );
+    }
+    free( lp_src );
+
+    /*----------------------------------------------------------------
+     * Stamp and write the image in one shot. A failed write just
+     * leaves the next startup on the cold path again.
+     *--------------------------------------------------------------*/
+    memset( &header, 0, sizeof( header ) );
+    header.magic        = RC_MAGIC;
+    header.version      = RC_VERSION;
+    header.srcMtimeSec  = rcStat.st_mtim.tv_sec;
+    header.srcMtimeNsec = rcStat.st_mtim.tv_nsec;
+    header.srcSize      = rcStat.st_size;
+    header.checksum     = RcChecksum( rcImageBuf, rcImageLen );
+    header.numCmds      = rcImageCmds;
+    header.payloadLen   = (unsigned)rcImageLen;
+
+    fd = open( cachePath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600 );
+    if( fd != -1 )
+    {
+        if( write( fd, &header, sizeof( header ) ) == -1
+         || write( fd, rcImageBuf, rcImageLen ) == -1 )
+        {
+            ;
+        }
+        close( fd );
+    }
+
+    free( rcImageBuf );
+    rcImageBuf = NULL;
+    rcImageCap = 0;
+    rcImageLen = 0;
+
+    return( EXIT_SUCCESS );
+
+} /* end - RcCompile() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      RcImagePut
+ *
+ * DESCRIPTION
+ *      This function appends bytes to the rc compiler's scratch image,
+ *      doubling the buffer as needed.
+ *
+ ****************************************************************************/
+
+static int RcImagePut
+    (
+    const void         *data,           /* The bytes to append              */
+    size_t              len             /* How many bytes to append         */
+    )
+{
+    if( rcImageLen + len > rcImageCap )
+    {
+        rcImageCap = ( rcImageCap == 0 ) ? 1024 : rcImageCap * 2;
+        while( rcImageLen + len > rcImageCap )
+        {
+            rcImageCap *= 2;
+        }
+        rcImageBuf = realloc( rcImageBuf, rcImageCap );
+    }
+    memcpy( &rcImageBuf[ rcImageLen ], data, len );
+    rcImageLen += len;
+
+    return( EXIT_SUCCESS );
+
+} /* end - RcImagePut() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      RcLoad
+ *
+ * DESCRIPTION
+ *      This function sources ~/.smallshrc at startup. Warm startups replay
+ *      the compiled cache kept beside it - one mmap and a checksum - and
+ *      the cold path (first run, edited rc, damaged cache) falls back to
+ *      sourcing the text while recompiling the cache for next time. A
+ *      missing rc file is not an error; most appliances have none.
+ *
+ ****************************************************************************/
+
+static int RcLoad
+    (
+    cmdStruct          *command         /* Scratch command struct to reuse  */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    char        cachePath[ PATH_MAX_LEN ];
+    char       *lp_home;
+    char        rcPath[ PATH_MAX_LEN ];
+    struct stat rcStat;
+    int         status;
+
+    lp_home = EnvLookup( HOME_ENV );
+    if( lp_home == NULL )
+    {
+        return( EXIT_FAILURE );
+    }
+    snprintf( rcPath,    sizeof( rcPath ),    "%s/%s", lp_home, RC_FILE );
+    snprintf( cachePath, sizeof( cachePath ), "%s/%s", lp_home, RC_CACHE_FILE );
+
+    /* No rc file, no work. */
+    if( stat( rcPath, &rcStat ) == -1 )
+    {
+        return( EXIT_SUCCESS );
+    }
+
+    status = RcLoadCached( cachePath, &rcStat, command );
+    if( status != EXIT_SUCCESS )
+    {
+        status = RcCompile( rcPath, cachePath, command );
+    }
+
+    /* Safe point: emit anything the rc commands queued. */
+    UTL_FlushOutput();
+
+    return( status );
+
+} /* end - RcLoad() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      RcLoadCached
+ *
+ * DESCRIPTION
+ *      This function replays the compiled rc cache. The mapping is private
+ *      and writable so the tokenizer (and builtins that split tokens in
+ *      place) may scribble on it without touching the file. The cache is
+ *      rejected - and the caller recompiles - when its header does not
+ *      match the rc source's mtime and size, when the payload fails its
+ *      checksum, or when a record walks outside the mapping.
+ *
+ ****************************************************************************/
+
+static int RcLoadCached
+    (
+    const char         *cachePath,      /* The compiled image to try        */
+    const struct stat  *rcStat,         /* Fresh stat of the rc source      */
+    cmdStruct          *command         /* Scratch command struct to reuse  */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    int                 argCount;
+    int                 blobLen;
+    struct stat         cacheStat;
+    int                 fd;
+    char               *lp_blob;
+    rcCacheHeader      *lp_header;
+    unsigned char      *lp_map;
+    unsigned char      *lp_payload;
+    int                *lp_rec;
+    size_t              mapLen;
+    size_t              need;
+    int                 numStages;
+    int                 off;
+    size_t              pos;
+
+    fd = open( cachePath, O_RDONLY | O_CLOEXEC );
+    if( fd == -1 )
+    {
+        return( EXIT_FAILURE );
+    }
+    fstat( fd, &cacheStat );
+    mapLen = cacheStat.st_size;
+    if( mapLen < sizeof( rcCacheHeader ) )
+    {
+        close( fd );
+        return( EXIT_FAILURE );
+    }
+
+    lp_map = mmap( NULL, mapLen, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if( lp_map == MAP_FAILED )
+    {
+        return( EXIT_FAILURE );
+    }
+
+    /* Gate on the source's identity, then on payload integrity. */
+    lp_header  = (rcCacheHeader *)lp_map;
+    lp_payload = lp_map + sizeof( rcCacheHeader );
+    if( lp_header->magic        != RC_MAGIC
+     || lp_header->version      != RC_VERSION
+     || lp_header->srcMtimeSec  != (long long)rcStat->st_mtim.tv_sec
+     || lp_header->srcMtimeNsec != (long long)rcStat->st_mtim.tv_nsec
+     || lp_header->srcSize      != (long long)rcStat->st_size
+     || lp_header->payloadLen   != mapLen - sizeof( rcCacheHeader )
+     || lp_header->checksum     != RcChecksum( lp_payload,
+                                               lp_header->payloadLen ) )
+    {
+        munmap( lp_map, mapLen );
+        return( EXIT_FAILURE );
+    }
+
+    /* Replay each record straight out of the mapping. */
+    pos = 0;
+    for( unsigned i = 0; i < lp_header->numCmds; i++ )
+    {
+        if( pos + 2 * sizeof( int ) > lp_header->payloadLen )
+        {
+            munmap( lp_map, mapLen );
+            return( EXIT_FAILURE );
+        }
+        lp_rec = (int *)( lp_payload + pos );
+
+        if( lp_rec[ 0 ] == RC_REC_TEXT )
+        {
+            need = 2 * sizeof( int ) + lp_rec[ 1 ];
+            if( lp_rec[ 1 ] <= 0 || pos + need > lp_header->payloadLen )
+            {
+                munmap( lp_map, mapLen );
+                return( EXIT_FAILURE );
+            }
+            /* Re-parse in place; the private mapping absorbs the
+               tokenizer's NUL writes. */
+            RunCommandList( (char *)( lp_rec + 2 ), command );
+            FreeArgs( command );
+        }
+        else if( lp_rec[ 0 ] == RC_REC_TOKENS )
+        {
+            argCount  = lp_rec[ 1 ];
+            numStages = lp_rec[ 2 ];
+            blobLen   = lp_rec[ 6 ];
+            need = ( 7 + numStages + argCount ) * sizeof( int ) + blobLen;
+            if( argCount  <= 0 || argCount  > MAX_ARGS
+             || numStages <= 0 || numStages > MAX_STAGES
+             || blobLen   <  0 || pos + need > lp_header->payloadLen )
+            {
+                munmap( lp_map, mapLen );
+                return( EXIT_FAILURE );
+            }
+
+            /*-----------------------------------------------
+             * Rebuild the command struct with its token
+             * pointers aimed straight into the mapped blob;
+             * no tokenizing, copying, or expansion runs.
+             *---------------------------------------------*/
+            ResetCommand( command );
+            command->argCount         = argCount;
+            command->numStages        = numStages;
+            command->isBackground     = ( lp_rec[ 3 ] & RC_FLAG_BACKGROUND ) != 0;
+            command->isRedirectInput  = ( lp_rec[ 3 ] & RC_FLAG_REDIR_IN   ) != 0;
+            command->isRedirectOutput = ( lp_rec[ 3 ] & RC_FLAG_REDIR_OUT  ) != 0;
+            command->isAppendOutput   = ( lp_rec[ 3 ] & RC_FLAG_APPEND     ) != 0;
+
+            lp_blob = (char *)( lp_rec + 7 + numStages + argCount );
+            for( int s = 0; s < numStages; s++ )
+            {
+                command->stageStart[ s ] = lp_rec[ 7 + s ];
+            }
+            for( int a = 0; a < argCount; a++ )
+            {
+                off = lp_rec[ 7 + numStages + a ];
+                command->args[ a ] = ( off >= 0 && off < blobLen )
+                                   ? &lp_blob[ off ] : NULL;
+            }
+            command->input  = ( lp_rec[ 4 ] >= 0 && lp_rec[ 4 ] < blobLen )
+                            ? &lp_blob[ lp_rec[ 4 ] ] : NULL;
+            command->output = ( lp_rec[ 5 ] >= 0 && lp_rec[ 5 ] < blobLen )
+                            ? &lp_blob[ lp_rec[ 5 ] ] : NULL;
+
+            /* Same hold RunCommandList takes around its targeted waits. */
+            reapHold = TRUE;
+            RunCommand( command );
+            reapHold = FALSE;
+            FreeArgs( command );
+        }
+        else
+        {
+            munmap( lp_map, mapLen );
+            return( EXIT_FAILURE );
+        }
+        pos += need;
+    }
+
+    munmap( lp_map, mapLen );
+
+    return( EXIT_SUCCESS );
+
+} /* end - RcLoadCached() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      ReapReport
+ *
+ * DESCRIPTION
+ *      This function does the per-exit accounting for one reaped child:
+ *      records the finished job, queues the completion notice, and frees
+ *      the child's job table slot. Shared by the ring drain and the
+ *      deferred WNOHANG pass in ReapZombies.
+ *
+ ****************************************************************************/
+
+static int ReapReport
+    (
+    pid_t               pid,            /* The reaped child's pid           */
+    int                 status,         /* Its raw wait status              */
+    struct rusage      *usage           /* Its resource usage at exit       */
+    )
+{
+    UTL_Trace( UTL_TRACE_REAP, pid, status );
+
+    /* Record the finished job before its table slot is freed. */
+    JobRecordAdd( pid, status, usage );
+
+    /*---------------------------------------------------------------
+     * Queue the completion notice rather than printing it eagerly:
+     * a burst of exits becomes one write at the next safe point
+     * instead of two fflush(NULL) calls per reaped child.
+     *-------------------------------------------------------------*/
+    UTL_QueueOutput( "background pid %d is done: ", pid );
+
+    /* If child was terminated by signal, inform user. */
+    if( WIFSIGNALED( status ) )
+    {
+        UTL_QueueOutput( "terminated by signal %d\n", WTERMSIG( status ) );
+    }
+    /* Otherwise, inform user of exit status. */
+    else
+    {
+        UTL_QueueOutput( "exit value %d\n", status );
+    }
+
+    /* Find and remove child from pids array. */
+    RemoveChildPid( pid );
+
+    return( EXIT_SUCCESS );
+
+} /* end - ReapReport() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      ReapZombies
+ *
+ * DESCRIPTION
+ *      This function accounts for terminated child processes. The common
+ *      path drains the handler's exit ring - one ready-made record per
+ *      exit, no polling. A WNOHANG sweep runs only when the handler had
+ *      to defer (an exit raced a foreground wait, or the ring filled),
+ *      picking up whatever zombies were left behind.
+ *
+ ****************************************************************************/
+
+static int ReapZombies(void)
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    chldEvent      *lp_event;
+    pid_t           pid;
+    struct rusage   usage;
+
+    /* Drain the exit ring: O(exits), statuses already captured. */
+    while( chldRingTail != chldRingHead )
+    {
+        lp_event    = &chldRing[ chldRingTail ];
+        childStatus = lp_event->status;
+
+        ReapReport( lp_event->pid, lp_event->status, &lp_event->usage );
+
+        chldRingTail = ( chldRingTail + 1 ) & ( CHLD_RING_SIZE - 1 );
+    }
+
+    /*---------------------------------------------------------------
+     * Exits the handler had to leave behind show up only as the
+     * deferred flag; one WNOHANG sweep collects those stragglers.
+     * Skipped entirely in the common case.
+     *-------------------------------------------------------------*/
+    if( chldDeferred == TRUE )
+    {
+        chldDeferred = FALSE;
+        while( ( pid = wait4( -1, &childStatus, WNOHANG, &usage ) ) > 0 )
+        {
+            ReapReport( pid, childStatus, &usage );
+        }
+    }
+
+    return( EXIT_SUCCESS );
+
+} /* end - ReapZombies() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      RemoveChildPid
+ *
+ * DESCRIPTION
+ *      This function removes a given pid from the job table. The pid's
+ *      slot is found through the hash index and pushed back on the free
+ *      list, so removal is O(1) regardless of job count.
+ *
+ ****************************************************************************/
+
+static int RemoveChildPid
+    (
+    pid_t               pid             /* The pid to remove from bg array  */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    int         slot;
+
+    /* Look up and unindex the pid in one probe sequence. */
+    slot = JobHashDelete( pid );
+    if( slot == -1 )
+    {
+        return( EXIT_FAILURE );
+    }
+
+    UTL_DebugPrint( "Removing pid %d from slot %d\n", pid, slot );
+
+    /* Clear the slot and push it back on the free list. */
+    jobTable[ slot ].pid      = 0;
+    jobTable[ slot ].nextFree = jobFreeHead;
+    jobFreeHead               = slot;
+    jobCount -= 1;
+
+    return( EXIT_SUCCESS );
+
+} /* end - RemoveChildPid() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      ResetCommand
+ *
+ * DESCRIPTION
+ *      This function clears a command struct between loop iterations. Only
+ *      the args slots the previous command actually used are NULLed (the
+ *      rest are NULL by induction from the one-time zeroing in main), so
+ *      a typical short command touches a few dozen bytes instead of the
+ *      full 4KB memset per iteration and the struct stays cache-hot.
+ *
+ ****************************************************************************/
+
+static int ResetCommand
+    (
+    cmdStruct          *command         /* The command struct to reset      */
+    )
+{
+    /* Clear only the slots filled by the previous command. */
+    for( int i = 0; i < command->argCount; i++ )
+    {
+        command->args[ i ] = NULL;
+    }
+
+    command->argCount           = 0;
+    command->input              = NULL;
+    command->output             = NULL;
+    /* Close out any here-string memfd the last command left behind. */
+    if( command->hereFd != -1 )
+    {
+        close( command->hereFd );
+        command->hereFd = -1;
+    }
+    command->isRedirectInput    = FALSE;
+    command->isRedirectOutput   = FALSE;
+    command->isAppendOutput     = FALSE;
+    command->isBackground       = FALSE;
+    command->isConcurrent       = FALSE;
+    command->listSep            = LIST_SEP_NONE;
+    command->numStages          = 1;
+    command->stageStart[ 0 ]    = 0;
+
+    return( EXIT_SUCCESS );
+
+} /* end - ResetCommand() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      ResolvePath
+ *
+ * DESCRIPTION
+ *      This function resolves a command name to an absolute executable path
+ *      using a lazily-built hash cache over the PATH directories. A cache
+ *      hit costs a single access() revalidation instead of a stat() against
+ *      every PATH entry. The cache is invalidated wholesale when PATH
+ *      changes, and a stale entry is re-resolved in place when its target
+ *      disappears.
+ *
+ * NOTES
+ *      Returns NULL when the name contains a slash (already a path) or when
+ *      resolution fails, in which case the caller should fall back to
+ *      execvp().
+ *
+ ****************************************************************************/
+
+static char *ResolvePath
+    (
+    char               *name            /* The command name to resolve      */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    char        candidate[ PATH_MAX_LEN ];
+    const char *lp_dir;
+    const char *lp_end;
+    size_t      dirLen;
+    char       *lp_pathEnv;
+    size_t      slot;
+
+    /* Names containing a slash are already paths; let exec use them as-is. */
+    if( strchr( name, '/' ) != NULL )
+    {
+        return( NULL );
+    }
+
+    lp_pathEnv = getenv( PATH_ENV );
+    if( lp_pathEnv == NULL )
+    {
+        return( NULL );
+    }
+
+    /*----------------------------------------------------------------
+     * Invalidate the whole cache when PATH differs from the value it
+     * was built against, or when the table is getting too full for
+     * open addressing to behave.
+     *--------------------------------------------------------------*/
+    if( pathCacheEnv == NULL || strcmp( pathCacheEnv, lp_pathEnv ) != 0
+     || pathCacheCount >= PATH_CACHE_SIZE / 2 )
+    {
+        /* A genuine PATH change also invalidates the completion index. */
+        if( pathCacheEnv != NULL && strcmp( pathCacheEnv, lp_pathEnv ) != 0 )
+        {
+            pathIndexStale = TRUE;
+        }
+        PathCacheReset();
+        pathCacheEnv = strdup( lp_pathEnv );
+    }
+
+    /* Probe the open-addressed table for the command name. */
+    slot = HashString( name ) & ( PATH_CACHE_SIZE - 1 );
+    while( pathCache[ slot ].name != NULL )
+    {
+        if( strcmp( pathCache[ slot ].name, name ) == 0 )
+        {
+            /* Revalidate the hit; executables can disappear under us. */
+            if( pathCache[ slot ].path != NULL
+             && access( pathCache[ slot ].path, X_OK ) == 0 )
+            {
+                return( pathCache[ slot ].path );
+            }
+
+            /* Stale entry. Drop the path and re-resolve into this slot. */
+            free( pathCache[ slot ].path );
+            pathCache[ slot ].path = NULL;
+            break;
+        }
+        slot = ( slot + 1 ) & ( PATH_CACHE_SIZE - 1 );
+    }
+
+    /*----------------------------------------------------------------
+     * Cache miss. Walk the PATH directories once looking for an
+     * executable candidate.
+     *--------------------------------------------------------------*/
+    lp_dir = lp_pathEnv;
+    while( *lp_dir != '\0' )
+    {
+        lp_end = strchr( lp_dir, ':' );
+        dirLen = ( lp_end != NULL ) ? (size_t)( lp_end - lp_dir ) : strlen( lp_dir );
+
+        if( dirLen > 0 && dirLen + strlen( name ) + 2 < sizeof( candidate ) )
+        {
+            snprintf( candidate, sizeof( candidate ), "%.*s/%s", (int)dirLen, lp_dir, name );
+            if( access( candidate, X_OK ) == 0 )
+            {
+                /* Found it. Record the resolution in the cache. */
+                if( pathCache[ slot ].name == NULL )
+                {
+                    pathCache[ slot ].name = strdup( name );
+                    pathCacheCount += 1;
+                }
+                pathCache[ slot ].path = strdup( candidate );
+
+                UTL_DebugPrint( "Resolved %s to %s\n", name, pathCache[ slot ].path );
+
+                return( pathCache[ slot ].path );
+            }
+        }
+
+        /* Advance to the next PATH component. */
+        lp_dir += dirLen;
+        if( *lp_dir == ':' )
+        {
+            lp_dir += 1;
+        }
+    }
+
+    /* Not found anywhere on PATH. Caller falls back to execvp. */
+    return( NULL );
+
+} /* end - ResolvePath() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      RunCommand
+ *
+ * DESCRIPTION
+ *      This function runs the most recently entered and parsed command.
+ *      A leading 'time' keyword is peeled off first and brackets the rest
+ *      of the command with CLOCK_MONOTONIC_RAW and RUSAGE_CHILDREN
+ *      snapshots, printing wall/user/sys afterwards with no extra fork
+ *      the way /usr/bin/time would cost.
+ *
+ * NOTES
+ *      Returns EXIT_FAILURE when the member failed - a builtin handler
+ *      reporting failure, or an external command exiting non-zero - so
+ *      the '&&' gate in RunCommandList works for both kinds of member.
+ *
+ ****************************************************************************/
+
+static int RunCommand
+    (
+    cmdStruct          *command         /* The command to run               */ 
+    )
+{
+    /* Don't dereference NULL pointers */
+    if( command == NULL )
+    {
+        fprintf( stderr, "Invalid Command Struct provided.\n" );
+        return( EXIT_FAILURE );
+    }
+
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    builtinEntry       *lp_builtin;
+    int                 memberStatus;
+    struct timespec     timeEnd;
+    struct timespec     timeStart;
+    bool                timed;
+    struct rusage       usageAfter;
+    struct rusage       usageBefore;
+    unsigned long long  wallNs;
+
+    /******************************
+    *  INITIALIZE VARIABLES
+    ******************************/
+    memberStatus = EXIT_SUCCESS;
+    timed        = FALSE;
+
+    /*---------------------------------------------------------------
+     * 'time' prefix: shift it off and bracket whatever follows with
+     * the raw monotonic clock and a RUSAGE_CHILDREN snapshot. No
+     * extra process is involved, so short commands measure clean.
+     *-------------------------------------------------------------*/
+    if( command->args[ 0 ] != NULL && command->args[ 1 ] != NULL
+     && strcmp( command->args[ 0 ], TIME_CMD ) == 0 )
+    {
+        /* Shift the prefix off; stage starts move down with it. */
+        for( int i = 0; i < command->argCount; i++ )
+        {
+            command->args[ i ] = command->args[ i + 1 ];
+        }
+        command->argCount -= 1;
+        for( int i = 1; i < command->numStages; i++ )
+        {
+            command->stageStart[ i ] -= 1;
+        }
+
+        timed = TRUE;
+        getrusage( RUSAGE_CHILDREN, &usageBefore );
+        clock_gettime( CLOCK_MONOTONIC_RAW, &timeStart );
+    }
 
     /* Skip blank lines */
     if( command->args[ 0 ] == NULL )
@@ -1001,36 +6553,229 @@ static int RunCommand
         UTL_DebugPrint( "Comment Detected %s\n", command->args[ 0 ] );
         ;
     }
-    /* Run CD command using built-in function. */
-    else if( strncmp( command->args[ 0 ], CD_CMD, CD_LEN ) == 0 )
-    {
-        UTL_DebugPrint( "CD Detected %s\n", command->args[0] );
-        MyChangeDir( command );
-    }
-    /* Run Exit command using built-in function. */
-    else if( strncmp( command->args[ 0 ], EXIT_CMD, EXIT_LEN ) == 0 )
+    /*---------------------------------------------------------------
+     * Dispatch through the builtin table: one hashed probe decides
+     * between a builtin handler and the external launch path, so
+     * external commands no longer pay a string compare per builtin.
+     *-------------------------------------------------------------*/
+    else if( ( lp_builtin = BuiltinLookup( command->args[ 0 ] ) ) != NULL )
     {
-        UTL_DebugPrint( "EXIT Detected %s\n", command->args[0] );
-        MyExit( command );
-    }
-    /* Run Status command using built-in function. */
-    else if( strncmp( command->args[ 0 ], STATUS_CMD, STATUS_LEN ) == 0 )
-    {
-        UTL_DebugPrint( "STATUS Detected %s\n", command->args[ 0 ] );
-        MyStatus();
+        UTL_DebugPrint( "Builtin %s Detected\n", lp_builtin->name );
+        memberStatus = lp_builtin->handler( command );
     }
     /* Run all other commands by forking a child process and calling exec(). */
     else
     {
         UTL_DebugPrint( "External Command Detected %s\n", command->args[ 0 ] );
         ExternalCommand( command );
+
+        /* The foreground wait left the child's status in childStatus. */
+        if( childStatus != 0 )
+        {
+            memberStatus = EXIT_FAILURE;
+        }
     }
 
-    return( EXIT_SUCCESS );
+    /*---------------------------------------------------------------
+     * Close the timing bracket. User and sys come from the children
+     * rusage delta - exactly what the foreground wait accumulated -
+     * and wall from the raw monotonic clock, good to the nanosecond.
+     *-------------------------------------------------------------*/
+    if( timed == TRUE )
+    {
+        clock_gettime( CLOCK_MONOTONIC_RAW, &timeEnd );
+        getrusage( RUSAGE_CHILDREN, &usageAfter );
+
+        wallNs = ( timeEnd.tv_sec - timeStart.tv_sec )
+               * (unsigned long long)NSEC_PER_SEC
+               + (unsigned long long)( timeEnd.tv_nsec - timeStart.tv_nsec );
+
+        UTL_FlushedPrintOut( "wall %.3f ms  user %.3f ms  sys %.3f ms\n",
+            wallNs / 1000000.0,
+            ( usageAfter.ru_utime.tv_sec  - usageBefore.ru_utime.tv_sec )  * 1000.0
+          + ( usageAfter.ru_utime.tv_usec - usageBefore.ru_utime.tv_usec ) / 1000.0,
+            ( usageAfter.ru_stime.tv_sec  - usageBefore.ru_stime.tv_sec )  * 1000.0
+          + ( usageAfter.ru_stime.tv_usec - usageBefore.ru_stime.tv_usec ) / 1000.0 );
+    }
+
+    return( memberStatus );
 
 } /* end - RunCommand() */
 
 
+/*****************************************************************************
+ *
+ * NAME
+ *      RunCommandList
+ *
+ * DESCRIPTION
+ *      This function parses and runs every member of a command list. A
+ *      line with no ';' or '&&' separators behaves exactly as before.
+ *      '&&' members run sequentially and are skipped (through the rest of
+ *      their '&&' chain) once a member fails. ';' members run strictly in
+ *      order by default; when SMALLSH_JOBS opts into fan-out, external ';'
+ *      members launch as concurrent children - up to the configured cap in
+ *      flight, waiting on the oldest member when the cap is hit - and the
+ *      whole line joins before returning, so command lists keep their
+ *      usual "done when the line is done" behavior while the members
+ *      themselves overlap.
+ *
+ ****************************************************************************/
+
+static int RunCommandList
+    (
+    char               *line,           /* The full input line              */
+    cmdStruct          *command         /* Scratch command struct to reuse  */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    pid_t           active[ SCHED_MAX_ACTIVE ];
+    bool            concurrent;
+    char           *lp_next;
+    size_t          numActive;
+    int             prevSep;
+    int             runStatus;
+    int             sep;
+    bool            skipMember;
+    struct timespec stageStart;
+    struct rusage   usage;
+
+    /******************************
+    *  INITIALIZE VARIABLES
+    ******************************/
+    lp_next     = line;
+    numActive   = 0;
+    prevSep     = LIST_SEP_NONE;
+    skipMember  = FALSE;
+
+    /*----------------------------------------------------------------
+     * Hold off handler-side reaping for the whole list: every wait4
+     * below names a specific pid, and the handler stealing one of
+     * them would turn that wait into ECHILD.
+     *--------------------------------------------------------------*/
+    reapHold = TRUE;
+
+    for(;;)
+    {
+        ResetCommand( command );
+
+        StatsBegin( &stageStart );
+        ParseCommand( lp_next, command );
+        StatsRecord( STAT_STAGE_PARSE, &stageStart );
+        /* Subsequent members continue the tokenizer on the same line. */
+        lp_next = NULL;
+        sep     = command->listSep;
+
+        /* A ';' boundary ends any failed '&&' chain being skipped. */
+        if( prevSep == LIST_SEP_SEQ )
+        {
+            skipMember = FALSE;
+        }
+
+        if( skipMember == FALSE )
+        {
+            /*---------------------------------------------------------------
+             * A member is eligible for concurrent dispatch when the user
+             * opted into fan-out via SMALLSH_JOBS and it sits on a ';'
+             * boundary rather than in an '&&' chain. Only external
+             * commands fan out; builtins run in-process.
+             *-------------------------------------------------------------*/
+            concurrent = schedMaxActive > 0
+                      && ( sep == LIST_SEP_SEQ
+                        || ( sep == LIST_SEP_NONE && prevSep == LIST_SEP_SEQ ) )
+                      && command->isBackground == FALSE
+                      && command->args[ 0 ] != NULL
+                      && strncmp( command->args[ 0 ], COMMENT, COMMENT_LEN ) != 0
+                      && BuiltinLookup( command->args[ 0 ] ) == NULL;
+
+            if( concurrent == TRUE )
+            {
+                /* Cap reached: retire the oldest member before launching. */
+                if( numActive >= schedMaxActive )
+                {
+                    foregroundChild = TRUE;
+                    UTL_FlushOutput();
+                    wait4( active[ 0 ], &childStatus, 0, &usage );
+                    JobRecordAdd( active[ 0 ], childStatus, &usage );
+                    RemoveChildPid( active[ 0 ] );
+                    foregroundChild = FALSE;
+                    numActive -= 1;
+                    memmove( &active[ 0 ], &active[ 1 ], numActive * sizeof( pid_t ) );
+                }
+
+                command->isConcurrent = TRUE;
+                schedLastPid          = -1;
+
+                StatsBegin( &stageStart );
+                RunCommand( command );
+                StatsRecord( STAT_STAGE_RUN, &stageStart );
+
+                if( schedLastPid > 0 )
+                {
+                    active[ numActive ] = schedLastPid;
+                    numActive += 1;
+                }
+            }
+            else
+            {
+                StatsBegin( &stageStart );
+                runStatus = RunCommand( command );
+                StatsRecord( STAT_STAGE_RUN, &stageStart );
+
+                /*-------------------------------------------------------
+                 * Gate the rest of an '&&' chain on this member's
+                 * status. RunCommand reports it for builtins and
+                 * external commands alike, so a failed cd short-
+                 * circuits the same way a failed external does.
+                 *-----------------------------------------------------*/
+                if( sep == LIST_SEP_AND && runStatus != EXIT_SUCCESS )
+                {
+                    skipMember = TRUE;
+                }
+            }
+        }
+
+        if( sep == LIST_SEP_NONE )
+        {
+            break;
+        }
+        prevSep = sep;
+    }
+
+    /* Join: the line completes when every concurrent member has. */
+    if( numActive > 0 )
+    {
+        foregroundChild = TRUE;
+        UTL_FlushOutput();
+        for( size_t i = 0; i < numActive; i++ )
+        {
+            wait4( active[ i ], &childStatus, 0, &usage );
+            JobRecordAdd( active[ i ], childStatus, &usage );
+            RemoveChildPid( active[ i ] );
+        }
+        foregroundChild = FALSE;
+
+        /* If the last member was terminated by a signal, display it. */
+        if( WIFSIGNALED( childStatus ) )
+        {
+            UTL_FlushedPrintOut( "terminated by signal %d\n", WTERMSIG( childStatus ) );
+        }
+        /* If the last member exited with a non-0 status, get that status. */
+        else if( childStatus != 0 )
+        {
+            childStatus = WIFEXITED( childStatus );
+        }
+    }
+
+    reapHold = FALSE;
+
+    return( EXIT_SUCCESS );
+
+} /* end - RunCommandList() */
+
+
 /*****************************************************************************
  *
  * NAME
@@ -1038,13 +6783,29 @@ static int RunCommand
  *
  * DESCRIPTION
  *      This function installs the signal handlers for the parent process. It
- *      will ignore SIGINT signals, and it will install HandleSIGCHLD and 
- *      HandleSIGTSTP.
+ *      will ignore SIGINT signals, and it will install HandleSIGCHLD,
+ *      HandleSIGTSTP, and HandleSIGUSR1.
  *  
  ****************************************************************************/
 
 static int SetSignalHandlers(void)
 {
+    /*-----------------------------------------------------------------------
+     * Create the SIGCHLD self-pipe before installing the handler that
+     * writes to it. Both ends are non-blocking (the handler must never
+     * stall) and close-on-exec so children don't inherit them.
+     *---------------------------------------------------------------------*/
+    if( pipe( sigChldPipe ) == -1 )
+    {
+        fprintf( stderr, "Failed to create SIGCHLD self-pipe\n" );
+        exit( EXIT_FAILURE );
+    }
+    for( int i = 0; i < 2; i++ )
+    {
+        fcntl( sigChldPipe[ i ], F_SETFL, O_NONBLOCK );
+        fcntl( sigChldPipe[ i ], F_SETFD, FD_CLOEXEC );
+    }
+
     /* Ignore SIGINT */
     struct sigaction SIGINT_action = {0};
 
@@ -1069,7 +6830,298 @@ static int SetSignalHandlers(void)
     SIGTSTP_action.sa_flags = SA_RESTART;
 
     sigaction( SIGTSTP, &SIGTSTP_action, NULL );
-    
+
+    /* Set up and register SIGUSR1 handler */
+    struct sigaction SIGUSR1_action = {0};
+
+    SIGUSR1_action.sa_handler = HandleSIGUSR1;
+    sigfillset( &SIGUSR1_action.sa_mask );
+    SIGUSR1_action.sa_flags = SA_RESTART;
+
+    sigaction( SIGUSR1, &SIGUSR1_action, NULL );
+
     return( EXIT_SUCCESS );
 
 } /* end - SetSignalHandlers() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      SpawnCommand
+ *
+ * DESCRIPTION
+ *      This function is the default launch engine. It launches the command
+ *      with posix_spawn, expressing the redirect and /dev/null plumbing as
+ *      spawn file actions and the child signal setup as spawn attributes,
+ *      so no address-space duplication is paid per launch. posix_spawn
+ *      resets caught signals (SIGCHLD, SIGTSTP) to their defaults in the
+ *      child on its own; SIGTSTP is additionally blocked via the spawn
+ *      signal mask to match the fork path's SIG_IGN behavior.
+ *
+ * NOTES
+ *      Returns EXIT_FAILURE without creating a child when spawn cannot
+ *      launch the command (e.g. command not found), in which case the
+ *      caller falls back to ForkCommand for its error reporting.
+ *
+ ****************************************************************************/
+
+static int SpawnCommand
+    (
+    cmdStruct          *command,        /* The command to run as a child    */
+    char               *resolved,       /* Cached absolute path, or NULL    */
+    pid_t              *pid             /* Out: pid of the spawned child    */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    posix_spawnattr_t           attr;
+    sigset_t                    blockSet;
+    sigset_t                    defaultSet;
+    posix_spawn_file_actions_t  fileActions;
+    int                         inputFd;
+    int                         outputFd;
+    int                         spawnErr;
+
+    /******************************
+    *  INITIALIZE VARIABLES
+    ******************************/
+    inputFd     = -1;
+    outputFd    = -1;
+
+    /*---------------------------------------------------------------
+     * Open redirect targets in the parent through the fd cache, so
+     * a loop redirecting into the same file reuses one open fd. The
+     * cache owns the fds; the child just dup2s them over its stdio.
+     * An open failure falls back to ForkCommand for its reporting.
+     *-------------------------------------------------------------*/
+    if( command->isRedirectOutput == TRUE )
+    {
+        UTL_DebugPrint( "Redirecting stdout to %s\n", command->output );
+        outputFd = UTL_RedirOpen( command->output,
+            O_WRONLY | O_CREAT | ( ( command->isAppendOutput == TRUE ) ? O_APPEND : O_TRUNC ) );
+        if( outputFd == -1 )
+        {
+            return( EXIT_FAILURE );
+        }
+    }
+    /*---------------------------------------------------------------
+     * Background processes that aren't otherwise redirecting their
+     * inputs or outputs will have their inputs/outputs redirected
+     * from/to dev/null, respectively.
+     *-------------------------------------------------------------*/
+    else if( command->isBackground == TRUE )
+    {
+        outputFd = UTL_RedirOpen( DEV_NULL, O_WRONLY );
+    }
+    /* A here-string payload beats a file redirect for stdin. */
+    if( command->hereFd != -1 )
+    {
+        lseek( command->hereFd, 0, SEEK_SET );
+        inputFd = command->hereFd;
+    }
+    else if( command->isRedirectInput == TRUE )
+    {
+        UTL_DebugPrint( "Redirecting stdin from %s\n", command->input );
+        inputFd = UTL_RedirOpen( command->input, O_RDONLY );
+        if( inputFd == -1 )
+        {
+            return( EXIT_FAILURE );
+        }
+    }
+    else if( command->isBackground == TRUE )
+    {
+        inputFd = UTL_RedirOpen( DEV_NULL, O_RDONLY );
+    }
+
+    posix_spawn_file_actions_init( &fileActions );
+    posix_spawnattr_init( &attr );
+
+    /* Plumb the cached fds onto the child's stdio. */
+    if( outputFd != -1 )
+    {
+        posix_spawn_file_actions_adddup2( &fileActions, outputFd, STDOUT_FILENO );
+    }
+    if( inputFd != -1 )
+    {
+        posix_spawn_file_actions_adddup2( &fileActions, inputFd, STDIN_FILENO );
+    }
+
+    /*---------------------------------------------------------------
+     * Foreground processes stop ignoring SIGINT. Background ones
+     * keep the parent's SIG_IGN disposition by staying out of the
+     * default set.
+     *-------------------------------------------------------------*/
+    sigemptyset( &defaultSet );
+    sigaddset( &defaultSet, SIGCHLD );
+    if( command->isBackground == FALSE )
+    {
+        sigaddset( &defaultSet, SIGINT );
+    }
+    posix_spawnattr_setsigdefault( &attr, &defaultSet );
+
+    /* Block SIGTSTP in the child, mirroring the fork path's SIG_IGN. */
+    sigemptyset( &blockSet );
+    sigaddset( &blockSet, SIGTSTP );
+    posix_spawnattr_setsigmask( &attr, &blockSet );
+
+    posix_spawnattr_setflags( &attr, POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK );
+
+    /*---------------------------------------------------------------
+     * Spawn the child. A cached resolution lets us spawn the
+     * absolute path directly, skipping the PATH walk.
+     *-------------------------------------------------------------*/
+    if( resolved != NULL )
+    {
+        spawnErr = posix_spawn( pid, resolved, &fileActions, &attr,
+                                command->args, environ );
+    }
+    else
+    {
+        spawnErr = posix_spawnp( pid, command->args[ 0 ], &fileActions, &attr,
+                                 command->args, environ );
+    }
+
+    posix_spawn_file_actions_destroy( &fileActions );
+    posix_spawnattr_destroy( &attr );
+
+    if( spawnErr != 0 )
+    {
+        UTL_DebugPrint( "posix_spawn failed with %d\n", spawnErr );
+        *pid = -1;
+        return( EXIT_FAILURE );
+    }
+
+    UTL_DebugPrint( "Spawned Process: %d\n", *pid );
+    UTL_Trace( UTL_TRACE_EXEC, *pid, 0 );
+
+    return( EXIT_SUCCESS );
+
+} /* end - SpawnCommand() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      StatsBegin
+ *
+ * DESCRIPTION
+ *      This function captures a stage start timestamp from the raw
+ *      monotonic clock. Paired with StatsRecord around each instrumented
+ *      stage.
+ *
+ ****************************************************************************/
+
+static void StatsBegin
+    (
+    struct timespec    *start           /* Out: stage start timestamp      */
+    )
+{
+    clock_gettime( CLOCK_MONOTONIC_RAW, start );
+
+} /* end - StatsBegin() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      StatsRecord
+ *
+ * DESCRIPTION
+ *      This function accumulates one completed stage interval into the
+ *      stage's log2-bucketed histogram: one clock read, a subtraction, and
+ *      two increments, so the cost of carrying the instrumentation is
+ *      negligible next to the stages it measures.
+ *
+ ****************************************************************************/
+
+static void StatsRecord
+    (
+    int                 stage,          /* Which stage completed            */
+    struct timespec    *start           /* The stage's start timestamp      */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    int                 bucket;
+    unsigned long long  deltaNs;
+    struct timespec     end;
+
+    clock_gettime( CLOCK_MONOTONIC_RAW, &end );
+
+    deltaNs = ( end.tv_sec - start->tv_sec ) * (unsigned long long)NSEC_PER_SEC
+            + ( end.tv_nsec - start->tv_nsec );
+
+    /* Bucket by the highest set bit (log2 of the interval). */
+    bucket = 0;
+    if( deltaNs > 0 )
+    {
+        bucket = 63 - __builtin_clzll( deltaNs );
+    }
+
+    statHistograms[ stage ].count              += 1;
+    statHistograms[ stage ].totalNs            += deltaNs;
+    statHistograms[ stage ].buckets[ bucket ]  += 1;
+
+} /* end - StatsRecord() */
+
+
+/*****************************************************************************
+ *
+ * NAME
+ *      TokenNext
+ *
+ * DESCRIPTION
+ *      This function carves the next space- or newline-separated token out
+ *      of the input line, NUL-terminating it in place like strtok but
+ *      locating delimiters through the vectorized scanners, 16 bytes per
+ *      step, instead of walking bytes one at a time. Pass the line on the
+ *      first call and NULL to continue; the cursor is shared across
+ *      callers the same way strtok's state was.
+ *
+ * NOTES
+ *      Returns NULL when the line has no tokens left.
+ *
+ ****************************************************************************/
+
+static char *TokenNext
+    (
+    char               *buf             /* Line to tokenize, or NULL to
+                                           continue the previous line       */
+    )
+{
+    /******************************
+    *  LOCAL VARIABLES
+    ******************************/
+    char       *lp_token;
+
+    if( buf != NULL )
+    {
+        tokenCursor = buf;
+    }
+    if( tokenCursor == NULL )
+    {
+        return( NULL );
+    }
+
+    /* Skip leading delimiters, then measure the token. */
+    tokenCursor += UTL_ScanSkip( tokenCursor, ' ', '\n' );
+    if( *tokenCursor == '\0' )
+    {
+        return( NULL );
+    }
+    lp_token     = tokenCursor;
+    tokenCursor += UTL_ScanSpan( tokenCursor, ' ', '\n' );
+
+    /* Terminate in place and resume past the delimiter next time. */
+    if( *tokenCursor != '\0' )
+    {
+        *tokenCursor  = '\0';
+        tokenCursor  += 1;
+    }
+
+    return( lp_token );
+
+} /* end - TokenNext() */
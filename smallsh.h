@@ -24,15 +24,26 @@
  *                DEFINES
  ********************************************/
 
-#define BUF_SIZE        (2049)
 #define MAX_ARGS        (512)
-#define MAX_CHILDREN    (10)
+#define MAX_STAGES      (16)
 
 /* Arguments */
 #define PID_VAR         ("$$")
 #define INPUT           ("<")
 #define OUTPUT          (">")
+#define APPEND          (">>")
 #define BACKGROUND      ("&")
+#define PIPE_OP         ("|")
+#define HERE_OP         ("<<<")
+#define SUBST_OPEN      ("$(")
+#define SUBST_CLOSE     (')')
+#define SEQ_OP          (";")
+#define AND_OP          ("&&")
+
+/* Which separator ended a command-list member. */
+#define LIST_SEP_NONE   (0)
+#define LIST_SEP_SEQ    (1)
+#define LIST_SEP_AND    (2)
 
 /* Commands */
 #define COMMENT         ("#")
@@ -43,7 +54,19 @@
 #define EXIT_LEN        (5)
 #define STATUS_CMD      ("status")
 #define STATUS_LEN      (7)
+#define STATS_CMD       ("stats")
+#define STATS_LEN       (6)
+#define JOBS_CMD        ("jobs")
+#define EXPORT_CMD      ("export")
+#define ALIAS_CMD       ("alias")
+#define TIME_CMD        ("time")
+#define FG_CMD          ("fg")
+#define BG_CMD          ("bg")
 #define HOME_ENV        ("HOME")
+#define DAEMON_FLAG     ("--daemon")
+#define CLIENT_FLAG     ("--client")
+#define PATH_ENV        ("PATH")
+#define JOBS_ENV        ("SMALLSH_JOBS")
 
 /* Background redirection */
 #define DEV_NULL        ("/dev/null")
@@ -56,11 +79,33 @@
 typedef struct cmdStruct
 {
     char   *args[MAX_ARGS];
+    /* Number of args slots the command actually used, so reset only
+       touches those instead of memsetting the whole array. */
+    int     argCount;
     char   *input;
     char   *output;
     bool    isRedirectInput;
     bool    isRedirectOutput;
+    /* Memfd holding a here-string payload, or -1. Takes priority over
+       input when plumbing the child's stdin. */
+    int     hereFd;
+    /* Output redirection appends (>>) instead of truncating (>). */
+    bool    isAppendOutput;
     bool    isBackground;
+    /*---------------------------------------------------------------
+     * Command-list state. listSep records which separator (if any)
+     * ended this member; isConcurrent marks a ';' member the list
+     * scheduler launched without waiting and will join later.
+     *-------------------------------------------------------------*/
+    int     listSep;
+    bool    isConcurrent;
+    /*---------------------------------------------------------------
+     * Pipeline stages. Stages are stored back-to-back in args with a
+     * NULL separator between them; stageStart indexes the first
+     * argument of each stage. Single commands have numStages == 1.
+     *-------------------------------------------------------------*/
+    int     numStages;
+    int     stageStart[MAX_STAGES];
 } cmdStruct;
 
 /*********************************************